@@ -3,20 +3,20 @@
 # Function to install packages using apt (Debian/Ubuntu)
 install_with_apt() {
     sudo apt update
-    sudo apt install -y ffmpeg exiftool jq libglfw3 libglfw3-dev yt-dlp
+    sudo apt install -y ffmpeg libglfw3 libglfw3-dev yt-dlp
 }
 
 # Function to install packages using yum (Red Hat/CentOS)
 install_with_yum() {
     sudo yum install -y epel-release
-    sudo yum install -y ffmpeg perl-Image-ExifTool jq glfw glfw-devel
+    sudo yum install -y ffmpeg glfw glfw-devel
     sudo yum install -y https://download1.rpmfusion.org/free/el/rpmfusion-free-release-$(rpm -E %rhel).noarch.rpm
     sudo yum install -y yt-dlp
 }
 
 # Function to install packages using pacman (Arch Linux)
 install_with_pacman() {
-    sudo pacman -Sy --noconfirm ffmpeg exiftool jq glfw yt-dlp
+    sudo pacman -Sy --noconfirm ffmpeg glfw yt-dlp
 }
 
 if [ -f /etc/arch-release ]; then
@@ -27,7 +27,7 @@ elif [ -f /etc/redhat-release ] || [ -f /etc/centos-release ]; then
   install_with_yum
 else
   echo "Your linux distro is not supported currently."
-  echo "You need to manually install those packages: exiftool, jq, glfw"
+  echo "You need to manually install those packages: glfw"
 fi
 
 
@@ -0,0 +1,111 @@
+#include "artworkRegistry.hpp"
+#include "config.hpp"
+#include "global.hpp"
+#include "ringBuffer.hpp"
+#include "textureUploader.hpp"
+#include "thumbnailCache.hpp"
+
+#include <list>
+#include <unordered_map>
+
+enum class ArtworkState {
+  Decoding = 0,
+  Uploading,
+  Resident
+};
+
+struct ArtworkEntry {
+  ArtworkState state = ArtworkState::Decoding;
+  LfTexture texture = {0};
+  uint64_t size = 0;
+  uint64_t lastUsedFrame = 0;
+  // Position in 'lru', only valid while the entry is resident
+  std::list<uint64_t>::iterator lruPos;
+};
+
+struct DecodedArtwork {
+  uint64_t artworkHash;
+  TextureData pixels;
+};
+
+static std::unordered_map<uint64_t, ArtworkEntry> artworks;
+// Resident artwork, the most recently rendered comes first
+static std::list<uint64_t> lru;
+static uint64_t residentSize = 0;
+static uint64_t frame = 0;
+
+// Filled by the decode jobs, drained in update()
+static MpscQueue<DecodedArtwork> decoded;
+
+static void touch(ArtworkEntry& entry) {
+  entry.lastUsedFrame = frame;
+  if(entry.state == ArtworkState::Resident)
+    lru.splice(lru.begin(), lru, entry.lruPos);
+}
+
+static void evict() {
+  // Artwork that was rendered this or the last frame is on screen and stays
+  while(residentSize > THUMBNAIL_VRAM_BUDGET && !lru.empty()) {
+    auto it = artworks.find(lru.back());
+    if(it->second.lastUsedFrame + 1 >= frame) break;
+    if(it->second.texture.width != 0)
+      lf_free_texture(&it->second.texture);
+    residentSize -= it->second.size;
+    lru.pop_back();
+    artworks.erase(it);
+  }
+}
+
+namespace ArtworkRegistry {
+  LfTexture get(uint64_t artworkHash, const std::filesystem::path& soundPath) {
+    if(artworkHash == 0) return (LfTexture){0};
+
+    auto it = artworks.find(artworkHash);
+    if(it != artworks.end()) {
+      touch(it->second);
+      return it->second.texture;
+    }
+
+    // Every other track with the same artwork waits for this one decode
+    ArtworkEntry& entry = artworks[artworkHash];
+    entry.lastUsedFrame = frame;
+    std::string path = soundPath.string();
+    state.jobSystem.submit([artworkHash, path](){
+        SoundTags tags{};
+        tags.artworkHash = artworkHash;
+        TextureData pixels = ThumbnailCache::getTrackThumbnailData(path, tags, PLAYLIST_FILE_THUMBNAIL_SIZE);
+        decoded.push((DecodedArtwork){.artworkHash = artworkHash, .pixels = pixels});
+        }, JobPriority::High);
+    return (LfTexture){0};
+  }
+
+  void update() {
+    frame++;
+
+    decoded.drain([](DecodedArtwork&& artwork){
+        ArtworkEntry& entry = artworks[artwork.artworkHash];
+        if(!artwork.pixels.data) {
+          // Nothing to upload, it stays resident without a texture
+          entry.state = ArtworkState::Resident;
+          lru.push_front(artwork.artworkHash);
+          entry.lruPos = lru.begin();
+          return;
+        }
+        // The uploader owns the pixels from here on and frees them once they are on the GPU
+        entry.size = (uint64_t)artwork.pixels.width * artwork.pixels.height * artwork.pixels.channels;
+        entry.state = ArtworkState::Uploading;
+        TextureUploader::enqueue(artwork.artworkHash, artwork.pixels);
+        });
+
+    TextureUploader::process([](uint64_t artworkHash, LfTexture texture) {
+        ArtworkEntry& entry = artworks[artworkHash];
+        entry.texture = texture;
+        entry.state = ArtworkState::Resident;
+        residentSize += entry.size;
+        lru.push_front(artworkHash);
+        entry.lruPos = lru.begin();
+        });
+
+    evict();
+  }
+}
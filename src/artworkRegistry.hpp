@@ -0,0 +1,24 @@
+#pragma once
+
+#include "textureData.hpp"
+
+extern "C" {
+#include <leif/leif.h>
+}
+
+#include <filesystem>
+
+#include <stdint.h>
+
+// Textures of track artwork, keyed by the artwork hash. Tracks with byte-identical
+// artwork (e.g. one album) share a single decode and a single texture.
+// Textures are only created for artwork that gets rendered and the least recently
+// rendered ones are evicted once they exceed THUMBNAIL_VRAM_BUDGET. Main thread only.
+namespace ArtworkRegistry {
+  // The row thumbnail of the artwork. If it is not on the GPU yet, it gets decoded on the
+  // job system and uploaded a few frames later, until then an empty texture is returned.
+  // Must be called every frame the artwork is visible, that keeps it from being evicted.
+  LfTexture get(uint64_t artworkHash, const std::filesystem::path& soundPath);
+  // Uploads decoded artwork within the per-frame budget and evicts unused textures. Once per frame.
+  void update();
+}
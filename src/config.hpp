@@ -60,6 +60,8 @@ extern "C" {
 #define PLAYLIST_ON_TRACK_CORNER_RADIUS 15.0f 
 #define PLAYLIST_FILE_THUMBNAIL_COLOR GRAY
 #define PLAYLIST_FILE_THUMBNAIL_SIZE (vec2s){48, 48}
+// Rows above and below the visible part of a playlist that are rendered anyway
+#define PLAYLIST_FILE_OVERSCAN_ROWS 4
 
 // Volume
 #define VOLUME_TOGGLE_STEP 5
@@ -67,6 +69,18 @@ extern "C" {
 #define VOLUME_INIT 75.0f
 #define VOLUME_SHOW_PERCENT true 
 
+// Audio output
+// The playback device is opened once with this format, every decoder converts to it
+#define SOUND_OUTPUT_FORMAT ma_format_f32
+#define SOUND_OUTPUT_CHANNELS 2
+#define SOUND_OUTPUT_SAMPLE_RATE 48000
+// Depth of the ring buffer that the decoder thread fills ahead of the device (~1.4s).
+// Both frame counts are rounded/expected to be powers of two.
+#define SOUND_DECODE_AHEAD_FRAMES 65536
+#define SOUND_DECODE_CHUNK_FRAMES 4096
+#define SOUND_DECODE_INTERVAL_MS 10 // How often the decoder thread checks for free space in the ring buffer
+#define SOUND_DURATION_PROBE_BYTES 65536 // Bytes read from the start/end of a file to find its duration headers
+
 // Buffers
 #define INPUT_BUFFER_SIZE 512
 
@@ -121,6 +135,34 @@ inline LfTheme ui_theme() {
   return theme;
 }
 
+// Metadata cache
+#define METADATA_CACHE_FILE LYSSA_DIR + std::string("/metadata.cache")
+#define THUMBNAIL_CACHE_DIR LYSSA_DIR + std::string("/thumbnails")
+#define PLAYLIST_COVER_SIZE 180
+
+// Playlist downloads
+// yt-dlp processes that download items of a playlist at the same time
+#define DOWNLOAD_CONCURRENCY 4
+// Attempts per item before it counts as failed
+#define DOWNLOAD_MAX_ATTEMPTS 3
+// Delete downloaded tracks that were removed from the source playlist when syncing
+#define PLAYLIST_SYNC_PRUNE_REMOVED false
+
+// Child processes
+// Time a terminated child gets to exit after SIGTERM before its process group gets SIGKILL
+#define PROCESS_TERMINATE_TIMEOUT_MS 3000
+
+// Playlist files
+// Size of the edit journal of a playlist before it gets folded into the playlist file
+#define PLAYLIST_JOURNAL_COMPACT_BYTES (64 * 1024)
+
+// Texture uploads
+#define TEXTURE_UPLOAD_BYTES_PER_FRAME (512 * 1024)
+#define TEXTURE_UPLOADS_PER_FRAME 64
+#define TEXTURE_UPLOAD_PBO_COUNT 3
+// GPU memory that row thumbnails may use before the least recently rendered ones are evicted
+#define THUMBNAIL_VRAM_BUDGET (32 * 1024 * 1024)
+
 // Async loading
 #define ASYNC_PLAYLIST_LOADING true 
 #define MIN_FILES_FOR_ASYNC 10
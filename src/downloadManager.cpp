@@ -0,0 +1,366 @@
+#include "downloadManager.hpp"
+#include "config.hpp"
+#include "json.hpp"
+#include "log.hpp"
+#include "processManager.hpp"
+#include "utils.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <unordered_set>
+
+#include <stdlib.h>
+#include <string.h>
+
+// Prefixes of the lines yt-dlp prints through --progress-template and --print
+#define PROGRESS_PREFIX "LYSSA_PROGRESS "
+#define FILE_PREFIX "LYSSA_FILE "
+
+// Files in the output directory. The archive is the one of yt-dlp, the track list maps
+// its ids to the downloaded files, one "<archive id>\t<filename>" per line.
+#define ARCHIVE_FILE "/archive.txt"
+#define TRACKS_FILE "/tracks.txt"
+
+static std::vector<DownloadItem> items;
+// Entries of the whole playlist, the file names are padded to its digit count
+static uint32_t entryCount = 0;
+static std::string outputDir;
+static std::function<void(const DownloadItem& item)> onItemFinished;
+static std::function<void()> onFinished;
+static bool running = false;
+static bool listed = false;
+static pid_t probePid = -1;
+
+static void schedule();
+
+static std::unordered_set<std::string> readArchive(const std::string& dir) {
+  std::unordered_set<std::string> archive;
+  std::ifstream file(dir + ARCHIVE_FILE);
+  std::string line;
+  while(std::getline(file, line)) {
+    if(!line.empty()) archive.insert(line);
+  }
+  return archive;
+}
+
+static std::vector<std::pair<std::string, std::string>> readTracks(const std::string& dir) {
+  std::vector<std::pair<std::string, std::string>> tracks;
+  std::ifstream file(dir + TRACKS_FILE);
+  std::string line;
+  while(std::getline(file, line)) {
+    size_t tab = line.find('\t');
+    if(tab == std::string::npos) continue;
+    tracks.emplace_back(line.substr(0, tab), line.substr(tab + 1));
+  }
+  return tracks;
+}
+
+// Deletes the tracks whose entries are not in the playlist anymore and forgets them in the
+// archive, so they would be downloaded again if they come back
+static void prune(const std::string& dir, const PlaylistInfo& info, 
+    const std::function<void(const std::string& path)>& onItemRemoved) {
+  std::unordered_set<std::string> remote;
+  for(auto& item : info.items) {
+    remote.insert(item.archiveId);
+  }
+
+  std::vector<std::pair<std::string, std::string>> tracks = readTracks(dir);
+  std::unordered_set<std::string> removed;
+  std::ofstream tracksFile(dir + TRACKS_FILE ".tmp");
+  for(auto& [archiveId, filename] : tracks) {
+    if(remote.count(archiveId)) {
+      tracksFile << archiveId << "\t" << filename << "\n";
+      continue;
+    }
+    removed.insert(archiveId);
+    std::string path = dir + "/" + filename;
+    if(onItemRemoved) onItemRemoved(path);
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+  }
+  tracksFile.close();
+  if(removed.empty()) {
+    std::filesystem::remove(dir + TRACKS_FILE ".tmp");
+    return;
+  }
+  std::filesystem::rename(dir + TRACKS_FILE ".tmp", dir + TRACKS_FILE);
+
+  std::unordered_set<std::string> archive = readArchive(dir);
+  std::ofstream archiveFile(dir + ARCHIVE_FILE ".tmp");
+  for(auto& archiveId : archive) {
+    if(!removed.count(archiveId)) archiveFile << archiveId << "\n";
+  }
+  archiveFile.close();
+  std::filesystem::rename(dir + ARCHIVE_FILE ".tmp", dir + ARCHIVE_FILE);
+  LOG_INFO("Pruned %zu tracks that were removed from the playlist.\n", removed.size());
+}
+
+// yt-dlp prints "NA" for fields it does not know
+static double parseField(const std::string& field) {
+  if(field == "NA" || field == "None") return 0.0;
+  return strtod(field.c_str(), nullptr);
+}
+
+static void parseProgress(DownloadItem& item, const std::string& line) {
+  std::istringstream iss(line.substr(strlen(PROGRESS_PREFIX)));
+  std::string downloaded, total, totalEstimate, speed, eta;
+  iss >> downloaded >> total >> totalEstimate >> speed >> eta;
+  item.downloadedBytes = (uint64_t)parseField(downloaded);
+  item.totalBytes = (uint64_t)parseField(total);
+  // Fragmented formats only have an estimate
+  if(item.totalBytes == 0)
+    item.totalBytes = (uint64_t)parseField(totalEstimate);
+  item.speed = parseField(speed);
+  item.eta = eta == "NA" || eta == "None" ? -1 : (int32_t)parseField(eta);
+}
+
+static void finishIfDone() {
+  if(!running || !listed) return;
+  for(auto& item : items) {
+    if(item.status == DownloadStatus::Queued || item.status == DownloadStatus::Running) return;
+  }
+  running = false;
+  // The callback may start the next batch
+  std::function<void()> callback = onFinished;
+  onItemFinished = nullptr;
+  onFinished = nullptr;
+  if(callback) callback();
+}
+
+static void startItem(uint32_t i) {
+  DownloadItem& item = items[i];
+
+  // Zero padded like yt-dlp pads %(playlist_index)s, so the files sort in playlist order
+  std::string index = std::to_string(item.index);
+  std::string count = std::to_string(entryCount);
+  if(index.size() < count.size())
+    index.insert(0, count.size() - index.size(), '0');
+
+  std::vector<std::string> argv = {
+    "yt-dlp", "--no-warnings", "--newline", "--progress",
+    "--extract-audio", "--audio-format", "mp3", "--embed-thumbnail", "--add-metadata",
+    "--progress-template", "download:" PROGRESS_PREFIX "%(progress.downloaded_bytes)s %(progress.total_bytes)s "
+      "%(progress.total_bytes_estimate)s %(progress.speed)s %(progress.eta)s",
+    "--print", "after_move:" FILE_PREFIX "%(filepath)s",
+    "--download-archive", outputDir + ARCHIVE_FILE,
+    "-o", outputDir + "/" + index + " - %(title)s.%(ext)s",
+    item.url
+  };
+
+  item.status = DownloadStatus::Running;
+  item.downloadedBytes = item.totalBytes = 0;
+  item.speed = 0.0;
+  item.eta = -1;
+  item.attempts++;
+  item.pid = ProcessManager::spawn(argv, 
+      [i](int32_t exitCode){
+      DownloadItem& item = items[i];
+      item.pid = -1;
+      item.speed = 0.0;
+      item.eta = -1;
+      if(exitCode == 0) {
+        item.status = DownloadStatus::Finished;
+        if(!item.path.empty() && !item.archiveId.empty()) {
+          std::ofstream tracks(outputDir + TRACKS_FILE, std::ios::app);
+          tracks << item.archiveId << "\t" << std::filesystem::path(item.path).filename().string() << "\n";
+        }
+        if(onItemFinished) onItemFinished(item);
+      } else if(item.attempts < DOWNLOAD_MAX_ATTEMPTS) {
+        LOG_INFO("Download of '%s' failed, trying again.\n", item.title.c_str());
+        item.status = DownloadStatus::Queued;
+      } else {
+        LOG_ERROR("Failed to download '%s' (%s).\n", item.title.c_str(), item.url.c_str());
+        item.status = DownloadStatus::Failed;
+      }
+      schedule();
+      }, 
+      [i](const std::string& line){
+      DownloadItem& item = items[i];
+      if(line.rfind(PROGRESS_PREFIX, 0) == 0) {
+        parseProgress(item, line);
+      } else if(line.rfind(FILE_PREFIX, 0) == 0) {
+        item.path = line.substr(strlen(FILE_PREFIX));
+      }
+      });
+  if(item.pid == -1) 
+    item.status = DownloadStatus::Failed;
+}
+
+static void schedule() {
+  uint32_t runningCount = 0;
+  for(auto& item : items) {
+    if(item.status == DownloadStatus::Running) runningCount++;
+  }
+  for(uint32_t i = 0; i < items.size() && runningCount < DOWNLOAD_CONCURRENCY; i++) {
+    if(items[i].status != DownloadStatus::Queued) continue;
+    startItem(i);
+    if(items[i].status == DownloadStatus::Running) runningCount++;
+  }
+  finishIfDone();
+}
+
+namespace DownloadManager {
+  void probe(const std::string& url, const std::function<void(bool ok, const PlaylistInfo& info)>& onProbed) {
+    if(probePid != -1) 
+      ProcessManager::terminate(probePid);
+
+    // -J prints the whole playlist as a single line of JSON once yt-dlp is done
+    auto output = std::make_shared<std::string>();
+    probePid = ProcessManager::spawn({"yt-dlp", "-J", "--flat-playlist", "--no-warnings", url}, 
+        [url, output, onProbed](int32_t exitCode){
+        probePid = -1;
+        PlaylistInfo info;
+        JsonValue json;
+        if(exitCode != 0 || !Json::parse(*output, json) || json.type != JsonType::Object) {
+          LOG_ERROR("Failed to fetch the playlist '%s'.\n", url.c_str());
+          onProbed(false, info);
+          return;
+        }
+        info.title = json.getString("title");
+
+        const JsonValue* entries = json.get("entries");
+        if(entries && entries->type == JsonType::Array) {
+          for(auto& entry : entries->array) {
+            // Unavailable videos come as null
+            if(entry.type != JsonType::Object) continue;
+            DownloadItem item;
+            item.index = info.items.size() + 1;
+            item.url = entry.getString("url", entry.getString("webpage_url"));
+            item.title = entry.getString("title", item.url);
+            std::string id = entry.getString("id");
+            std::string extractor = LyssaUtils::toLower(entry.getString("ie_key"));
+            if(!id.empty() && !extractor.empty()) 
+              item.archiveId = extractor + " " + id;
+            if(!item.url.empty()) info.items.emplace_back(item);
+          }
+        } else {
+          // A single video
+          DownloadItem item;
+          item.index = 1;
+          item.url = json.getString("webpage_url", url);
+          item.title = info.title;
+          std::string id = json.getString("id");
+          std::string extractor = LyssaUtils::toLower(json.getString("extractor_key"));
+          if(!id.empty() && !extractor.empty()) 
+            item.archiveId = extractor + " " + id;
+          info.items.emplace_back(item);
+        }
+        onProbed(true, info);
+        }, 
+        [output](const std::string& line){
+        output->append(line);
+        });
+    if(probePid == -1) 
+      onProbed(false, PlaylistInfo());
+  }
+
+  bool isProbing() {
+    return probePid != -1;
+  }
+
+  void start(const PlaylistInfo& info, const std::string& dir, 
+      const std::function<void(const DownloadItem& item)>& itemFinished, const std::function<void()>& finished) {
+    cancel();
+    outputDir = dir;
+    onItemFinished = itemFinished;
+    onFinished = finished;
+    running = true;
+    listed = true;
+    entryCount = info.items.size();
+
+    // Already downloaded entries are known from the archive, no need to ask yt-dlp about them
+    std::unordered_set<std::string> archive = readArchive(dir);
+    for(auto& item : info.items) {
+      if(item.archiveId.empty() || !archive.count(item.archiveId)) 
+        items.emplace_back(item);
+    }
+    schedule();
+  }
+
+  void sync(const std::string& url, const std::string& dir, bool pruneRemoved,
+      const std::function<void(const DownloadItem& item)>& itemFinished, 
+      const std::function<void(const std::string& path)>& itemRemoved, const std::function<void()>& finished) {
+    cancel();
+    running = true;
+    probe(url, [dir, pruneRemoved, itemFinished, itemRemoved, finished](bool ok, const PlaylistInfo& info){
+        if(!ok) {
+          running = false;
+          if(finished) finished();
+          return;
+        }
+        // An empty list is more likely a hiccup of the site than an emptied playlist
+        if(pruneRemoved && !info.items.empty()) 
+          prune(dir, info, itemRemoved);
+        start(info, dir, itemFinished, finished);
+        });
+  }
+
+  void cancel() {
+    if(probePid != -1) {
+      ProcessManager::terminate(probePid);
+      probePid = -1;
+    }
+    for(auto& item : items) {
+      if(item.pid != -1) 
+        ProcessManager::terminate(item.pid);
+    }
+    items.clear();
+    onItemFinished = nullptr;
+    onFinished = nullptr;
+    running = false;
+    listed = false;
+  }
+
+  void cancelItem(uint32_t i) {
+    if(i >= items.size()) return;
+    DownloadItem& item = items[i];
+    if(item.status != DownloadStatus::Queued && item.status != DownloadStatus::Running) return;
+    if(item.pid != -1) {
+      ProcessManager::terminate(item.pid);
+      item.pid = -1;
+    }
+    item.status = DownloadStatus::Cancelled;
+    item.speed = 0.0;
+    item.eta = -1;
+    schedule();
+  }
+
+  void retryItem(uint32_t i) {
+    if(!running || i >= items.size()) return;
+    DownloadItem& item = items[i];
+    if(item.status != DownloadStatus::Failed && item.status != DownloadStatus::Cancelled) return;
+    item.status = DownloadStatus::Queued;
+    item.attempts = 0;
+    schedule();
+  }
+
+  bool isRunning() {
+    return running;
+  }
+
+  bool isListed() {
+    return listed;
+  }
+
+  const std::vector<DownloadItem>& getItems() {
+    return items;
+  }
+
+  uint32_t getCount(DownloadStatus status) {
+    uint32_t count = 0;
+    for(auto& item : items) {
+      if(item.status == status) count++;
+    }
+    return count;
+  }
+
+  double getSpeed() {
+    double speed = 0.0;
+    for(auto& item : items) {
+      if(item.status == DownloadStatus::Running) speed += item.speed;
+    }
+    return speed;
+  }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <sys/types.h>
+
+enum class DownloadStatus {
+  Queued = 0,
+  Running,
+  Finished,
+  Failed,
+  Cancelled
+};
+
+struct DownloadItem {
+  // Position of the item in the playlist, starting at 1
+  uint32_t index;
+  std::string url, title;
+  // "<extractor> <id>" as yt-dlp writes it into the download archive
+  std::string archiveId;
+  // The downloaded file, set once yt-dlp has finished converting it
+  std::string path;
+  DownloadStatus status = DownloadStatus::Queued;
+  uint64_t downloadedBytes = 0, totalBytes = 0;
+  // Bytes per second
+  double speed = 0.0;
+  // Seconds, -1 if yt-dlp does not know yet
+  int32_t eta = -1;
+  uint32_t attempts = 0;
+  pid_t pid = -1;
+};
+
+// Title and entries of a playlist as yt-dlp reports them
+struct PlaylistInfo {
+  std::string title;
+  std::vector<DownloadItem> items;
+};
+
+// Downloads every item of a playlist with its own yt-dlp process, DOWNLOAD_CONCURRENCY at a
+// time. The progress is parsed from the output of yt-dlp as it comes in through
+// ProcessManager, so it only advances while ProcessManager::update() is called. Main thread only.
+namespace DownloadManager {
+  // Fetches the title and the entries of the playlist at 'url' with a single yt-dlp call.
+  // 'onProbed' gets them once yt-dlp exited, 'ok' is false if the URL is no playlist or video.
+  void probe(const std::string& url, const std::function<void(bool ok, const PlaylistInfo& info)>& onProbed);
+  bool isProbing();
+
+  // Downloads the entries of 'info' as mp3 into 'outputDir'. Entries that are in the
+  // archive.txt of 'outputDir' are left out without starting yt-dlp for them. 'onItemFinished'
+  // is called for every item that finished, its path is empty if yt-dlp skipped it.
+  // 'onFinished' is called once no item is queued or running anymore.
+  void start(const PlaylistInfo& info, const std::string& outputDir, 
+      const std::function<void(const DownloadItem& item)>& onItemFinished, const std::function<void()>& onFinished);
+  // Probes 'url' and downloads only the entries that are not in the archive of 'outputDir'.
+  // With 'prune', tracks whose entry was removed from the playlist are deleted and reported
+  // through 'onItemRemoved' first. 'onFinished' is also called if probing fails.
+  void sync(const std::string& url, const std::string& outputDir, bool prune,
+      const std::function<void(const DownloadItem& item)>& onItemFinished, 
+      const std::function<void(const std::string& path)>& onItemRemoved, const std::function<void()>& onFinished);
+  // Stops every item, 'onFinished' is not called
+  void cancel();
+
+  void cancelItem(uint32_t i);
+  // Queues a failed or cancelled item again
+  void retryItem(uint32_t i);
+
+  // True from start() until the batch finished or got cancelled
+  bool isRunning();
+  // False while the entries of the playlist are still being listed
+  bool isListed();
+  // The items of the current or last batch
+  const std::vector<DownloadItem>& getItems();
+  uint32_t getCount(DownloadStatus status);
+  // Sum of the throughput of all running items in bytes per second
+  double getSpeed();
+}
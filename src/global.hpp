@@ -7,6 +7,8 @@
 #include "popups.hpp"
 #include "playlists.hpp"
 #include "infoCard.hpp"
+#include "jobSystem.hpp"
+#include "ringBuffer.hpp"
 
 #include <memory>
 #include <string>
@@ -86,6 +88,18 @@ enum class PopupID {
   PopupCount
 };
 
+// The tags of a track that a loading job read, they are stored in the TrackLibrary
+struct LoadedSoundFile {
+  TrackId trackId;
+  SoundFile file;
+};
+
+// Pixels of a playlist cover that a job decoded, 'playlistPath' identifies the playlist
+struct DecodedCover {
+  std::filesystem::path playlistPath;
+  TextureData pixels;
+};
+
 struct GlobalState {
   Window* win = NULL;
   float deltaTime, lastTime;
@@ -95,7 +109,8 @@ struct GlobalState {
   SoundHandler soundHandler;
   InfoCardHandler infoCards;
 
-  SoundFile* currentSoundFile = NULL, *previousSoundFile = NULL;
+  // INVALID_TRACK_ID if nothing is playing
+  TrackId currentTrack = INVALID_TRACK_ID, previousTrack = INVALID_TRACK_ID;
   int32_t currentSoundPos, previousSoundPos;
 
   LfFont musicTitleFont,
@@ -114,9 +129,15 @@ struct GlobalState {
   std::vector<Playlist> playlists;
   std::unordered_map<PopupType, std::unique_ptr<Popup>> popups;
 
-  std::vector<uint32_t> alreadyPlayedTracks;
+  // Rows of the playing playlist that shuffle played already
+  std::vector<bool> alreadyPlayedTracks;
+  uint32_t playedTrackCount = 0;
   uint32_t skipDownAmount;
 
+  // Sound that is preloaded to play gapless after the current one
+  int32_t queuedSoundIndex;
+  bool queuedShuffle, queuedReplay;
+
   std::unordered_map<std::string, LfTexture> icons;
 
   CreatePlaylistState createPlaylistTab;
@@ -126,10 +147,7 @@ struct GlobalState {
   TrackFullscreenTab trackFullscreenTab;
 
 
-  int32_t currentPlaylist, playingPlaylist;
-
-  float soundPosUpdateTimer;
-  float soundPosUpdateTime;
+  int32_t currentPlaylist, playingPlaylist, loadingPlaylist;
 
   LfSlider trackProgressSlider;
   LfSlider volumeSlider;
@@ -139,16 +157,21 @@ struct GlobalState {
 
 
   // Async loading
-  std::vector<std::future<void>> playlistFileFutures;
+  JobSystem jobSystem;
+  // Jobs that load the files of loadingPlaylist, null if nothing is loading
+  std::shared_ptr<JobGroup> playlistFileJobs;
+  // Claims of the Normal priority loading jobs that were not boosted yet. A row that scrolls into
+  // view gets a High priority job with the same claim, whichever runs first loads the file.
+  std::unordered_map<TrackId, std::shared_ptr<std::atomic<bool>>> unboostedFileLoads;
+  // Filled by the loading jobs, drained by the main thread once per frame
+  MpscQueue<LoadedSoundFile> loadedPlaylistFiles;
   std::vector<std::future<void>> playlistFutures;
   std::vector<std::string> loadedPlaylistFilepaths;
-  std::vector<TextureData> playlistFileThumbnailData;
-  std::vector<TextureData> playlistThumbnailData;
-  std::mutex mutex;
+  // Playlist covers, uploaded by the main thread once per frame
+  MpscQueue<DecodedCover> decodedCovers;
 
 
   bool playlistDownloadRunning, playlistDownloadFinished;
-  int32_t playlistThumbnailDownloadIndex;
 
   std::string downloadingPlaylistName;
   uint32_t downloadPlaylistFileCount;
@@ -156,7 +179,7 @@ struct GlobalState {
   bool shuffle, replayTrack;
 
   InputField searchPlaylistInput;
-  std::vector<SoundFile> searchPlaylistResults;
+  std::vector<TrackId> searchPlaylistResults;
 };
 
 extern GlobalState state;
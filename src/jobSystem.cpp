@@ -0,0 +1,115 @@
+#include "jobSystem.hpp"
+
+#include <algorithm>
+
+void JobGroup::wait() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _done.wait(lock, [this](){ return _pending.load() == 0; });
+}
+
+void JobGroup::finish() {
+  if(--_pending != 0) return;
+  std::lock_guard<std::mutex> lock(_mutex);
+  _done.notify_all();
+}
+
+JobSystem::~JobSystem() {
+  shutdown();
+}
+
+void JobSystem::init(uint32_t threadCount) {
+  if(_running) return;
+  if(threadCount == 0)
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+  _running = true;
+  for(uint32_t i = 0; i < threadCount; i++) {
+    _workers.emplace_back(std::make_unique<Worker>());
+  }
+  for(uint32_t i = 0; i < threadCount; i++) {
+    _threads.emplace_back(&JobSystem::workerLoop, this, i);
+  }
+}
+
+void JobSystem::shutdown() {
+  if(!_running) return;
+  {
+    std::lock_guard<std::mutex> lock(_sleepMutex);
+    _running = false;
+  }
+  _wake.notify_all();
+  for(auto& thread : _threads) {
+    thread.join();
+  }
+  _threads.clear();
+
+  // Jobs that never ran still count as finished for their groups
+  for(auto& worker : _workers) {
+    for(auto& queue : worker->queues) {
+      for(auto& job : queue) {
+        if(job.group) job.group->finish();
+      }
+    }
+  }
+  _workers.clear();
+  _queuedJobs = 0;
+}
+
+void JobSystem::submit(std::function<void()> job, JobPriority priority, const std::shared_ptr<JobGroup>& group) {
+  if(group) group->add();
+  if(!_running) {
+    // Without workers the job runs right away
+    Job inlineJob = {.fn = std::move(job), .group = group};
+    runJob(inlineJob);
+    return;
+  }
+
+  // Counted before it is published, a worker that pops it right away must not decrement first
+  {
+    std::lock_guard<std::mutex> lock(_sleepMutex);
+    _queuedJobs++;
+  }
+  uint32_t index = _nextWorker++ % _workers.size();
+  {
+    std::lock_guard<std::mutex> lock(_workers[index]->mutex);
+    _workers[index]->queues[(uint32_t)priority].push_back((Job){.fn = std::move(job), .group = group});
+  }
+  _wake.notify_one();
+}
+
+void JobSystem::workerLoop(uint32_t index) {
+  while(true) {
+    Job job;
+    if(popJob(index, job)) {
+      _queuedJobs--;
+      runJob(job);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(_sleepMutex);
+    _wake.wait(lock, [this](){ return !_running || _queuedJobs.load() != 0; });
+    if(!_running) return;
+  }
+}
+
+bool JobSystem::popJob(uint32_t index, Job& job) {
+  uint32_t workerCount = _workers.size();
+  for(uint32_t priority = 0; priority < (uint32_t)JobPriority::Count; priority++) {
+    // Own queue first, then steal from the others at the same priority
+    for(uint32_t i = 0; i < workerCount; i++) {
+      Worker& worker = *_workers[(index + i) % workerCount];
+      std::lock_guard<std::mutex> lock(worker.mutex);
+      std::deque<Job>& queue = worker.queues[priority];
+      if(queue.empty()) continue;
+      job = std::move(queue.front());
+      queue.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void JobSystem::runJob(Job& job) {
+  if(!job.group || !job.group->isCancelled())
+    job.fn();
+  if(job.group) job.group->finish();
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+
+enum class JobPriority {
+  High = 0,   // Work for things that are visible right now
+  Normal,
+  Low,
+  Count
+};
+
+// A set of jobs that can be waited for and cancelled together.
+// Cancelling drops every job of the group that did not start yet.
+class JobGroup {
+  public:
+    void cancel() { _cancelled = true; }
+    bool isCancelled() const { return _cancelled.load(); }
+
+    // True once every submitted job of the group ran or was dropped
+    bool isDone() const { return _pending.load() == 0; }
+    void wait();
+
+  private:
+    friend class JobSystem;
+    void add() { _pending++; }
+    void finish();
+
+    std::atomic<uint32_t> _pending{0};
+    std::atomic<bool> _cancelled{false};
+    std::mutex _mutex;
+    std::condition_variable _done;
+};
+
+// Fixed-size pool with one worker per core. Every worker owns a queue per priority and
+// steals from the other workers once its own queues are empty. Higher priorities always
+// run first, across all workers.
+class JobSystem {
+  public:
+    ~JobSystem();
+
+    // Starts the workers, 0 uses the core count
+    void init(uint32_t threadCount = 0);
+    // Drops every job that did not start yet and joins the workers
+    void shutdown();
+
+    void submit(std::function<void()> job, JobPriority priority = JobPriority::Normal,
+        const std::shared_ptr<JobGroup>& group = nullptr);
+
+    uint32_t getThreadCount() const { return _threads.size(); }
+
+  private:
+    struct Job {
+      std::function<void()> fn;
+      std::shared_ptr<JobGroup> group;
+    };
+    struct Worker {
+      std::deque<Job> queues[(uint32_t)JobPriority::Count];
+      std::mutex mutex;
+    };
+
+    void workerLoop(uint32_t index);
+    bool popJob(uint32_t index, Job& job);
+    void runJob(Job& job);
+
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::vector<std::thread> _threads;
+    std::atomic<uint32_t> _nextWorker{0};
+    std::atomic<uint32_t> _queuedJobs{0};
+    std::atomic<bool> _running{false};
+
+    std::mutex _sleepMutex;
+    std::condition_variable _wake;
+};
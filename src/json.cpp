@@ -0,0 +1,198 @@
+#include "json.hpp"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+struct JsonParser {
+  const char* it;
+  const char* end;
+
+  void skipWhitespace() {
+    while(it != end && (*it == ' ' || *it == '\t' || *it == '\n' || *it == '\r')) it++;
+  }
+
+  bool consume(const char* literal) {
+    const char* p = it;
+    for(; *literal; literal++, p++) {
+      if(p == end || *p != *literal) return false;
+    }
+    it = p;
+    return true;
+  }
+
+  static void appendUtf8(std::string& str, uint32_t codepoint) {
+    if(codepoint < 0x80) {
+      str += (char)codepoint;
+    } else if(codepoint < 0x800) {
+      str += (char)(0xC0 | (codepoint >> 6));
+      str += (char)(0x80 | (codepoint & 0x3F));
+    } else if(codepoint < 0x10000) {
+      str += (char)(0xE0 | (codepoint >> 12));
+      str += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+      str += (char)(0x80 | (codepoint & 0x3F));
+    } else {
+      str += (char)(0xF0 | (codepoint >> 18));
+      str += (char)(0x80 | ((codepoint >> 12) & 0x3F));
+      str += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+      str += (char)(0x80 | (codepoint & 0x3F));
+    }
+  }
+
+  bool parseHex(uint32_t& value) {
+    if(end - it < 4) return false;
+    value = 0;
+    for(int i = 0; i < 4; i++, it++) {
+      char c = *it;
+      value <<= 4;
+      if(c >= '0' && c <= '9') value |= c - '0';
+      else if(c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+      else if(c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+      else return false;
+    }
+    return true;
+  }
+
+  bool parseString(std::string& str) {
+    // Opening quote is checked by the caller
+    it++;
+    while(it != end) {
+      char c = *it++;
+      if(c == '"') return true;
+      if(c != '\\') {
+        str += c;
+        continue;
+      }
+      if(it == end) return false;
+      char escape = *it++;
+      switch(escape) {
+        case '"':  str += '"'; break;
+        case '\\': str += '\\'; break;
+        case '/':  str += '/'; break;
+        case 'b':  str += '\b'; break;
+        case 'f':  str += '\f'; break;
+        case 'n':  str += '\n'; break;
+        case 'r':  str += '\r'; break;
+        case 't':  str += '\t'; break;
+        case 'u': {
+          uint32_t codepoint;
+          if(!parseHex(codepoint)) return false;
+          // Characters outside the BMP come as a surrogate pair (yt-dlp escapes all non-ASCII)
+          if(codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+            uint32_t low;
+            if(!consume("\\u") || !parseHex(low) || low < 0xDC00 || low > 0xDFFF) return false;
+            codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+          }
+          appendUtf8(str, codepoint);
+          break;
+        }
+        default:
+          return false;
+      }
+    }
+    return false;
+  }
+
+  bool parseNumber(JsonValue& value) {
+    // strtod stops at the first character that does not belong to the number
+    std::string number;
+    while(it != end && (isdigit((unsigned char)*it) || *it == '-' || *it == '+' || *it == '.' || *it == 'e' || *it == 'E')) {
+      number += *it++;
+    }
+    char* numberEnd;
+    value.type = JsonType::Number;
+    value.number = strtod(number.c_str(), &numberEnd);
+    return !number.empty() && *numberEnd == '\0';
+  }
+
+  bool parseValue(JsonValue& value, uint32_t depth) {
+    // Deeper than anything yt-dlp prints, guards the stack against garbage
+    if(depth > 64) return false;
+    skipWhitespace();
+    if(it == end) return false;
+
+    switch(*it) {
+      case '{': {
+        it++;
+        value.type = JsonType::Object;
+        skipWhitespace();
+        if(it != end && *it == '}') {
+          it++;
+          return true;
+        }
+        while(true) {
+          skipWhitespace();
+          if(it == end || *it != '"') return false;
+          std::string key;
+          if(!parseString(key)) return false;
+          skipWhitespace();
+          if(it == end || *it++ != ':') return false;
+          value.object.emplace_back(std::move(key), JsonValue());
+          if(!parseValue(value.object.back().second, depth + 1)) return false;
+          skipWhitespace();
+          if(it == end) return false;
+          char c = *it++;
+          if(c == '}') return true;
+          if(c != ',') return false;
+        }
+      }
+      case '[': {
+        it++;
+        value.type = JsonType::Array;
+        skipWhitespace();
+        if(it != end && *it == ']') {
+          it++;
+          return true;
+        }
+        while(true) {
+          value.array.emplace_back();
+          if(!parseValue(value.array.back(), depth + 1)) return false;
+          skipWhitespace();
+          if(it == end) return false;
+          char c = *it++;
+          if(c == ']') return true;
+          if(c != ',') return false;
+        }
+      }
+      case '"':
+        value.type = JsonType::String;
+        return parseString(value.string);
+      case 't':
+        value.type = JsonType::Bool;
+        value.boolean = true;
+        return consume("true");
+      case 'f':
+        value.type = JsonType::Bool;
+        value.boolean = false;
+        return consume("false");
+      case 'n':
+        value.type = JsonType::Null;
+        return consume("null");
+      default:
+        return parseNumber(value);
+    }
+  }
+};
+
+const JsonValue* JsonValue::get(const std::string& key) const {
+  for(auto& [name, member] : object) {
+    if(name == key) return &member;
+  }
+  return nullptr;
+}
+
+std::string JsonValue::getString(const std::string& key, const std::string& fallback) const {
+  const JsonValue* member = get(key);
+  if(!member || member->type != JsonType::String) return fallback;
+  return member->string;
+}
+
+namespace Json {
+  bool parse(const std::string& text, JsonValue& value) {
+    JsonParser parser = {.it = text.data(), .end = text.data() + text.size()};
+    value = JsonValue();
+    if(!parser.parseValue(value, 0)) return false;
+    parser.skipWhitespace();
+    return parser.it == parser.end;
+  }
+}
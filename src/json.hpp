@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+enum class JsonType {
+  Null = 0,
+  Bool,
+  Number,
+  String,
+  Array,
+  Object
+};
+
+struct JsonValue {
+  JsonType type = JsonType::Null;
+  bool boolean = false;
+  double number = 0.0;
+  std::string string;
+  std::vector<JsonValue> array;
+  // Members in the order they appear in the document
+  std::vector<std::pair<std::string, JsonValue>> object;
+
+  // The member 'key' of an object, nullptr if there is none
+  const JsonValue* get(const std::string& key) const;
+  // The member 'key' if it is a string, 'fallback' otherwise
+  std::string getString(const std::string& key, const std::string& fallback = "") const;
+};
+
+// Parser for the JSON that yt-dlp prints, so nothing needs to be piped through jq.
+namespace Json {
+  // Returns false if 'text' is not a single valid JSON value
+  bool parse(const std::string& text, JsonValue& value);
+}
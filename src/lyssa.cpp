@@ -1,9 +1,15 @@
 #include "config.hpp" 
+#include "artworkRegistry.hpp"
+#include "downloadManager.hpp"
 #include "log.hpp"
+#include "metadataCache.hpp"
 #include "playlists.hpp"
 #include "popups.hpp"
+#include "processManager.hpp"
 #include "soundHandler.hpp"
 #include "soundTagParser.hpp"
+#include "thumbnailCache.hpp"
+#include "textureUploader.hpp"
 #include "window.hpp"
 #include "utils.hpp"
 #include "global.hpp"
@@ -21,6 +27,7 @@
 #include <mutex>
 #include <sstream>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 extern "C" {
@@ -75,6 +82,7 @@ static void                     renderDashboardNav();
 static void                     renderCreatePlaylist(std::function<void()> onCreateCb = nullptr, std::function<void()> clientUICb = nullptr, std::function<void()> backButtonCb = nullptr);
 static void                     renderCreatePlaylistFromFolder();
 static void                     renderDownloadPlaylist();
+static void                     renderDownloadItems();
 static void                     renderOnPlaylist();
 static void                     renderOnTrack();
 static void                     renderTrackFullscreen();
@@ -107,8 +115,18 @@ static void                     updateFullscreenTrackTab();
 static void                     backButtonTo(GuiTab tab, const std::function<void()>& clickCb = nullptr);
 
 static void                     loadPlaylists();
-static void                     loadPlaylistFileAsync(std::vector<SoundFile>* files, std::string path);
-static void                     addFileToPlaylistAsync(std::vector<SoundFile>* files, std::string path, uint32_t playlistIndex);
+static void                     loadPlaylistCoverAsync(const Playlist& playlist);
+static void                     handleDecodedCovers();
+static void                     loadPlaylistFileAsync(TrackId trackId, std::string path);
+static void                     refreshPlaylistFileAsync(TrackId trackId, std::string path, FileStamp stamp);
+static void                     boostPlaylistFileLoading(TrackId trackId);
+static bool                     appendFileToPlaylistMetadata(const std::string& path, uint32_t playlistIndex);
+static void                     addFileToPlaylistAsync(const std::string& path, uint32_t playlistIndex);
+static void                     removeFileFromPlaylist(const std::string& path, uint32_t playlistIndex);
+static void                     openDownloadedPlaylist();
+static void                     startPlaylistDownload(const std::string& url, const std::string& name, const PlaylistInfo& info);
+static void                     finishPlaylistDownload(const std::string& url);
+static void                     finishPlaylistSync();
 
 static void                     moveFileInPlaylistIdx(uint32_t playlistIndex, uint32_t fromIndex, uint32_t toIndex);
 
@@ -117,8 +135,14 @@ static void                     playlistPlayFileWithIndex(uint32_t i, uint32_t p
 
 static void                     skipSoundUp(uint32_t playlistIndex);
 static void                     skipSoundDown(uint32_t playlistIndex);
+static int32_t                  getNextSoundIndex(uint32_t playlistIndex);
+static void                     queueNextSound(uint32_t playlistIndex);
+static void                     markSoundAsPlayed(uint32_t i, uint32_t playlistIndex);
+static int32_t                  getShuffledSoundIndex(const Playlist& playlist);
+static void                     handleTrackSwitch();
 
 static std::string              formatDurationToMins(int32_t duration);
+static std::string              formatBytes(double bytes);
 static void                     updateSoundProgress();
 
 static std::string              removeFileExtension(const std::string& filename);
@@ -130,13 +154,14 @@ static void                     loadIcons();
 
 static void                     handleAsyncPlaylistLoading();
 static void                     loadPlaylistAsync(Playlist& playlist);
+static void                     cancelPlaylistLoading();
 
-static LfClickableItemState     renderSoundFileThumbnail(vec2s thumbnailContainerSize, SoundFile& file, 
+static LfClickableItemState     renderSoundFileThumbnail(vec2s thumbnailContainerSize, TrackId trackId, 
                                                           const std::function<void()>& clickCb = nullptr, bool uiResponse = true, float cornerRadius = -1.0f);
 
 static bool                     renderMenuBarElement(const std::string& text, uint32_t iconId);
 
-static std::vector<SoundFile>   matchSoundFiles(const std::vector<SoundFile>& files, const std::string& searchTerm);
+static std::vector<TrackId>     matchSoundFiles(const std::vector<TrackId>& files, const std::string& searchTerm);
 static void                     searchPlaylistInputInsertCb(void* inputData);
 static void                     searchPlaylistInputKeyCb(void* inputData);
 
@@ -248,31 +273,17 @@ void handleTabKeyStrokes() {
   if(lf_key_went_down(GLFW_KEY_G)) {
     Playlist& favourites = state.playlists[0]; // 0th playlist is favourites
     Playlist& currentPlaylist = state.playlists[state.currentPlaylist]; 
-    std::filesystem::path selectedPath = currentPlaylist.musicFiles[currentPlaylist.playingFile].path;
+    std::filesystem::path selectedPath = TrackLibrary::getPath(currentPlaylist.musicFiles[currentPlaylist.playingFile]);
     if(!Playlist::metadataContainsFile(selectedPath.string(), 0)) {
       if(favourites.loaded) {
         Playlist::addFile(selectedPath, 0);
         favourites.loaded = false;
       } else {
-        std::ofstream metadata(favourites.path.string() + "/.metadata", std::ios::app);
-        metadata.seekp(0, std::ios::end);
-
-        metadata << "\"" << selectedPath.string() << "\" ";
-        metadata.close();
+        PlaylistMetadata::appendFile(favourites.path, selectedPath.string());
       }
       state.infoCards.addCard("Added to favourites.");
     } else {
-      if(!favourites.loaded) {
-        std::vector<std::string> paths = PlaylistMetadata::getFilepaths(
-            std::filesystem::directory_entry(state.playlists[0].path));
-        for(auto& path : paths) {
-          favourites.musicFiles.push_back((SoundFile){.path = path});
-        }
-        Playlist::removeFile(selectedPath.string(), 0);
-        favourites.musicFiles.clear();
-      } else {
-        Playlist::removeFile(selectedPath.string(), 0);
-      }
+      Playlist::removeFile(selectedPath.string(), 0);
       state.infoCards.addCard("Removed from favourites.");
     }
   }
@@ -295,11 +306,11 @@ if(lf_key_event().pressed && lf_key_event().happened) {
           } else {
             Playlist& currentPlaylist = state.playlists[state.currentPlaylist];
             if(currentPlaylist.playingFile == -1) return;
-            state.currentSoundFile = &currentPlaylist.musicFiles[currentPlaylist.playingFile];
+            state.currentTrack = currentPlaylist.musicFiles[currentPlaylist.playingFile];
             if(state.onTrackTab.trackThumbnail.width != 0) {
               lf_free_texture(&state.onTrackTab.trackThumbnail);
             }
-            state.onTrackTab.trackThumbnail = SoundTagParser::getSoundThubmnail(state.currentSoundFile->path, (vec2s){-1, -1});
+            state.onTrackTab.trackThumbnail = SoundTagParser::getSoundThubmnail(TrackLibrary::getPath(state.currentTrack), (vec2s){-1, -1});
             changeTabTo(GuiTab::OnTrack);
           }
           break;
@@ -338,8 +349,8 @@ if(lf_key_event().pressed && lf_key_event().happened) {
         {
           Playlist& currentPlaylist = state.playlists[state.currentPlaylist];
           playlistPlayFileWithIndex(currentPlaylist.selectedFile, state.currentPlaylist);
-          state.currentSoundFile = &currentPlaylist.musicFiles[currentPlaylist.playingFile];
-          float filePosY = currentPlaylist.musicFiles[currentPlaylist.playingFile].renderPosY;
+          state.currentTrack = currentPlaylist.musicFiles[currentPlaylist.playingFile];
+          float filePosY = currentPlaylist.getFileRenderPosY(currentPlaylist.playingFile);
           currentPlaylist.scroll = -filePosY;
           break;
         }
@@ -370,7 +381,7 @@ if(lf_key_event().pressed && lf_key_event().happened) {
           } else {
             currentPlaylist.selectedFile = 0;
           }
-          float filePosY = currentPlaylist.musicFiles[currentPlaylist.selectedFile].renderPosY;
+          float filePosY = currentPlaylist.getFileRenderPosY(currentPlaylist.selectedFile);
           currentPlaylist.scroll = -filePosY;
         }
         break;
@@ -383,7 +394,7 @@ if(lf_key_event().pressed && lf_key_event().happened) {
           } else {
             currentPlaylist.selectedFile = currentPlaylist.musicFiles.size() - 1;
           }
-          float filePosY = currentPlaylist.musicFiles[currentPlaylist.selectedFile].renderPosY;
+          float filePosY = currentPlaylist.getFileRenderPosY(currentPlaylist.selectedFile);
           currentPlaylist.scroll = -filePosY;
         }
         break;
@@ -646,7 +657,7 @@ static void renderHomepage() {
           if(state.soundHandler.isInit) {
             state.soundHandler.stop();
             state.soundHandler.uninit();
-            state.currentSoundFile = nullptr;
+            state.currentTrack = INVALID_TRACK_ID;
           }
           Playlist::remove(i);
           state.infoCards.addCard("Removed playlist.");
@@ -1037,14 +1048,13 @@ void renderCreatePlaylistFromFolder() {
         loadPlaylists();
         PlaylistAddFromFolderTab& tab = state.playlistAddFromFolderTab;
         uint32_t playlist = state.playlists.size() - 1;
-        std::ofstream metadata(state.playlists[playlist].path.string() + "/.metadata", std::ios::app);
-        metadata.seekp(0, std::ios::end);
+        std::vector<std::string> paths;
         for(const auto& entry : std::filesystem::directory_iterator(tab.currentFolderPath)) {
         if(!entry.is_directory() && SoundTagParser::isValidSoundFile(entry.path().string())) {
-        metadata << "\"" << entry.path().string() << "\" ";
+        paths.emplace_back(entry.path().string());
         }
         }
-        metadata.close();
+        PlaylistMetadata::appendFiles(state.playlists[playlist].path, paths);
         }, 
         [&](){
         LfUIElementProps props = call_to_action_button_style();
@@ -1074,8 +1084,8 @@ static std::string removeSpecialCharactersStr(const std::string& input) {
 }
 
 void renderDownloadPlaylist() {
-  std::string downloadedPlaylistDir = LYSSA_DIR + "/downloaded_playlists/" + state.downloadingPlaylistName; 
-  uint32_t downloadedFileCount = LyssaUtils::getLineCountFile(downloadedPlaylistDir + "/archive.txt");
+  uint32_t downloadedFileCount = DownloadManager::getCount(DownloadStatus::Finished);
+  uint32_t fileCount = DownloadManager::getItems().size();
 
   static std::string url;
 
@@ -1101,6 +1111,9 @@ void renderDownloadPlaylist() {
       props.color = GRAY;
       lf_push_style_props(props);
       std::string text = "Downloading of playlist \"" + state.downloadingPlaylistName + "\" with " + std::to_string(state.downloadPlaylistFileCount) + " files finished.";
+      uint32_t failedCount = DownloadManager::getCount(DownloadStatus::Failed) + DownloadManager::getCount(DownloadStatus::Cancelled);
+      if(failedCount != 0) 
+        text += " " + std::to_string(failedCount) + " files could not be downloaded.";
       lf_text(text.c_str());
       lf_pop_style_props();
       lf_pop_font();
@@ -1120,27 +1133,9 @@ void renderDownloadPlaylist() {
 
       lf_push_style_props(props);
       if(lf_button_fixed("Open Playlist", 180, -1) == LF_CLICKED) {
-        loadPlaylists();
         state.playlistDownloadRunning = false;
         state.playlistDownloadFinished = false;
-        uint32_t playlistIndex = 0;
-        for(uint32_t i = 0; i < state.playlists.size(); i++) {
-          if(state.playlists[i].name == state.downloadingPlaylistName) {
-            playlistIndex = i;
-            break;
-          }
-        }
-        state.currentPlaylist = playlistIndex;
-        auto& playlist = state.playlists[state.currentPlaylist];
-        if(!playlist.loaded) {
-          state.loadedPlaylistFilepaths.clear();
-          state.loadedPlaylistFilepaths.shrink_to_fit();
-
-          state.loadedPlaylistFilepaths = PlaylistMetadata::getFilepaths(std::filesystem::directory_entry(playlist.path));
-          loadPlaylistAsync(playlist);
-          playlist.loaded = true;
-        }
-        changeTabTo(GuiTab::OnPlaylist);
+        openDownloadedPlaylist();
       }
       lf_pop_style_props();
     }
@@ -1194,59 +1189,23 @@ void renderDownloadPlaylist() {
 
     {
       lf_push_style_props(call_to_action_button_style());
-      if(lf_button_fixed("Download", 150, -1) == LF_CLICKED) {
-        state.downloadingPlaylistName = LyssaUtils::getCommandOutput(
-            std::string("yt-dlp \"" + std::string(urlInput) + "\" --flat-playlist --dump-single-json --no-warnings | jq -r .title &"));
-        state.downloadingPlaylistName = removeSpecialCharactersStr(state.downloadingPlaylistName); 
-
-        if(state.downloadingPlaylistName != "null") {
-          std::string downloadCmd = LYSSA_DIR + "/scripts/download.sh \"" + urlInput + "\" " + LYSSA_DIR + "/downloaded_playlists/ &"; 
-          system(downloadCmd.c_str());
-          state.playlistDownloadRunning = true;
-          state.downloadPlaylistFileCount = LyssaUtils::getPlaylistFileCountURL(urlInput);
-          url = urlInput;
-          memset(urlInput, 0, INPUT_BUFFER_SIZE);
-        } else {
-          LOG_ERROR("Invalid URL Provided.");
-          memset(urlInput, 0, INPUT_BUFFER_SIZE);
-        }
+      // The probe runs in the background, the window keeps rendering meanwhile
+      bool probing = DownloadManager::isProbing();
+      if(lf_button_fixed(probing ? "Loading..." : "Download", 150, -1) == LF_CLICKED && !probing && strlen(urlInput) != 0) {
+        url = urlInput;
+        DownloadManager::probe(url, [](bool ok, const PlaylistInfo& info){
+            std::string name = removeSpecialCharactersStr(info.title);
+            if(!ok || name.empty()) {
+              LOG_ERROR("Invalid URL Provided.\n");
+              return;
+            }
+            startPlaylistDownload(url, name, info);
+            });
+        memset(urlInput, 0, INPUT_BUFFER_SIZE);
       }
       lf_pop_style_props();
     }
   } else  {
-    static float ytdlpDownTimer = 0.0f;
-    if(LyssaUtils::getCommandOutput("pgrep yt-dlp") == "") {
-      ytdlpDownTimer += state.deltaTime;
-      if(ytdlpDownTimer >= 2.0f) {
-        ytdlpDownTimer = 0.0f;
-        state.playlistDownloadFinished = true;
-      }
-    } else {
-      ytdlpDownTimer = 0.0f;
-    }
-      state.downloadPlaylistFileCount == LyssaUtils::getLineCountFile(LYSSA_DIR + "/downloaded_playlists/" + state.downloadingPlaylistName + "/archive.txt");
-
-    if(state.playlistDownloadFinished) {
-      FileStatus createStatus = Playlist::create(state.downloadingPlaylistName, "Downloaded Playlist", url);
-
-      if(createStatus != FileStatus::AlreadyExists) {
-        std::string playlistDir = LYSSA_DIR + "/playlists/" + state.downloadingPlaylistName; 
-        std::ofstream metadata(playlistDir + "/.metadata", std::ios::app);
-
-        metadata.seekp(0, std::ios::end);
-
-        for (const auto& entry : std::filesystem::directory_iterator(downloadedPlaylistDir)) {
-          if (entry.is_regular_file() && entry.path().extension() == ".mp3") {
-            metadata << "\"" << entry.path().string() << "\" ";
-          }
-        }
-        metadata.close();
-      }
-      std::string downloadThumbnailCmd = "yt-dlp --playlist-items 1 --skip-download --convert-thumbnails jpg --write-thumbnail -o \"" 
-        + LYSSA_DIR + "/playlists/" + state.downloadingPlaylistName + "/thumbnail.jpg\" " + url + " &";
-      system(downloadThumbnailCmd.c_str());
-    }
-
     {
       std::string title = std::string("Downloading " + state.downloadingPlaylistName + "...");
       LfUIElementProps props = lf_get_theme().text_props;
@@ -1259,7 +1218,9 @@ void renderDownloadPlaylist() {
       lf_pop_font();
       lf_next_line();
 
-      std::string subtitle = std::string("This can take a while.");
+      std::string subtitle = !DownloadManager::isListed() ? std::string("Fetching the playlist entries...") : 
+        std::to_string(downloadedFileCount) + " of " + std::to_string(fileCount) + " files, " + 
+        formatBytes(DownloadManager::getSpeed()) + "/s";
       props.margin_bottom = 15;
       lf_push_style_props(props);
       lf_text(subtitle.c_str());
@@ -1277,7 +1238,7 @@ void renderDownloadPlaylist() {
       lf_pop_style_props();
     }
     {
-      int percentage = (downloadedFileCount * 100) / state.downloadPlaylistFileCount;
+      int percentage = fileCount != 0 ? (downloadedFileCount * 100) / fileCount : 0;
       std::ostringstream oss;
       oss << percentage << "%";
 
@@ -1303,7 +1264,7 @@ void renderDownloadPlaylist() {
       props.margin_left = 15;
       props.margin_right = 0;
       lf_push_style_props(props);
-      lf_progress_bar_int(downloadedFileCount, 0, (float)state.downloadPlaylistFileCount, progressBarSize.x, progressBarSize.y);
+      lf_progress_bar_int(downloadedFileCount, 0, (float)(MAX(fileCount, 1)), progressBarSize.x, progressBarSize.y);
       lf_pop_style_props();
     }
 
@@ -1323,14 +1284,28 @@ void renderDownloadPlaylist() {
       lf_push_style_props(props);
       if(lf_button_fixed("Cancle", buttonSize, -1) == LF_CLICKED) {
         state.playlistDownloadRunning = false;
-        system("pkill yt-dlp &");
+        DownloadManager::cancel();
+      }
+      // The finished tracks can already be played
+      if(downloadedFileCount != 0 && state.playlistDownloadRunning) {
+        props.margin_left = 10;
+        lf_push_style_props(props);
+        if(lf_button_fixed("Open Playlist", buttonSize, -1) == LF_CLICKED) {
+          openDownloadedPlaylist();
+        }
+        lf_pop_style_props();
       }
       lf_pop_style_props();
     }
   }
   lf_div_end();
 
-  if(LyssaUtils::getCommandOutput("pgrep yt-dlp") == "") {
+  if(state.playlistDownloadRunning) {
+    lf_next_line();
+    renderDownloadItems();
+  }
+
+  if(!state.playlistDownloadRunning) {
     beginBottomNavBar();
     backButtonTo(GuiTab::Dashboard, [&](){
         loadPlaylists();
@@ -1340,46 +1315,92 @@ void renderDownloadPlaylist() {
   }
 }
 
-void renderOnPlaylist() {
-  Playlist& currentPlaylist = state.playlists[state.currentPlaylist];
+void renderDownloadItems() {
+  // Only the items that are in progress or need attention, finished ones are counted above
+  const std::vector<DownloadItem>& items = DownloadManager::getItems();
+  const vec2s progressBarSize = (vec2s){300, 4};
+  for(uint32_t i = 0; i < items.size(); i++) {
+    const DownloadItem& item = items[i];
+    if(item.status == DownloadStatus::Queued || item.status == DownloadStatus::Finished) continue;
 
-  static bool clearedPlaylist = false;
-
-  if(state.playlistDownloadRunning) {
-    if(!clearedPlaylist) {
-      currentPlaylist.musicFiles.clear();
-      state.loadedPlaylistFilepaths.clear();
-      state.playlistFileThumbnailData.clear();
-      Playlist::save(state.currentPlaylist);
-      clearedPlaylist = true;
+    {
+      LfUIElementProps props = lf_get_theme().text_props;
+      props.text_color = LF_WHITE;
+      props.margin_top = 10;
+      lf_push_style_props(props);
+      lf_push_font(&state.h6Font);
+      lf_text(item.title.c_str());
+      lf_pop_font();
+      lf_pop_style_props();
     }
+    lf_next_line();
 
+    if(item.status == DownloadStatus::Running) {
+      LfUIElementProps props = lf_get_theme().slider_props;
+      props.border_width = 0;
+      props.color = GRAY;
+      props.text_color = BLUE_GRAY;  
+      props.corner_radius = 1.5f;
+      props.margin_top = 10;
+      lf_push_style_props(props);
+      lf_progress_bar_int((float)item.downloadedBytes, 0, (float)(MAX(item.totalBytes, 1)), progressBarSize.x, progressBarSize.y);
+      lf_pop_style_props();
+    }
 
-    static float ytdlpDownTimer = 0.0f;
-    bool downloadFinished = false;
-    if(LyssaUtils::getCommandOutput("pgrep yt-dlp") == "") {
-      ytdlpDownTimer += state.deltaTime;
-      if(ytdlpDownTimer >= 2.0f) {
-        ytdlpDownTimer = 0.0f;
-        downloadFinished = true;
+    {
+      std::string info;
+      switch(item.status) {
+        case DownloadStatus::Running:
+          info = formatBytes(item.downloadedBytes) + " / " + formatBytes(item.totalBytes) + "  " + 
+            formatBytes(item.speed) + "/s" + (item.eta >= 0 ? "  " + formatDurationToMins(item.eta) : "");
+          break;
+        case DownloadStatus::Failed:
+          info = "Failed";
+          break;
+        case DownloadStatus::Cancelled:
+          info = "Cancelled";
+          break;
+        default:
+          break;
       }
-    } else {
-      ytdlpDownTimer = 0.0f;
-    }
-    if(downloadFinished) {
-      state.playlistDownloadRunning = false;
-      state.loadedPlaylistFilepaths = PlaylistMetadata::getFilepaths(std::filesystem::directory_entry(LYSSA_DIR + "/downloaded_playlists/" + state.downloadingPlaylistName));
-      for (const auto& entry : std::filesystem::directory_iterator(LYSSA_DIR + "/downloaded_playlists/" + state.downloadingPlaylistName)) {
-        if (entry.is_regular_file() && 
-            !Playlist::containsFile(entry.path().string(), state.currentPlaylist) && 
-            SoundTagParser::isValidSoundFile(entry.path().string()) && entry.path().extension() == ".mp3") {
-          state.loadedPlaylistFilepaths.emplace_back(entry.path().string());
-          state.playlistFileFutures.emplace_back(std::async(std::launch::async, addFileToPlaylistAsync, 
-                &state.playlists[state.currentPlaylist].musicFiles, entry.path().string(), state.currentPlaylist));
-        }
+      LfUIElementProps props = lf_get_theme().text_props;
+      props.text_color = lf_color_brightness(GRAY, 1.5);
+      lf_push_style_props(props);
+      lf_push_font(&state.h6Font);
+      lf_text(info.c_str());
+      lf_pop_font();
+      lf_pop_style_props();
+    }
+
+    {
+      LfUIElementProps props = lf_get_theme().button_props;
+      props.color = LYSSA_BACKGROUND_COLOR;
+      props.text_color = LF_WHITE;
+      props.border_color = GRAY;
+      props.border_width = 1.0f;
+      props.corner_radius = 6.0f;
+      lf_push_style_props(props);
+      lf_push_font(&state.h6Font);
+      if(item.status == DownloadStatus::Running) {
+        if(lf_button("Cancel") == LF_CLICKED) 
+          DownloadManager::cancelItem(i);
+      } else {
+        if(lf_button("Retry") == LF_CLICKED) 
+          DownloadManager::retryItem(i);
       }
+      lf_pop_font();
+      lf_pop_style_props();
     }
+    lf_next_line();
   }
+}
+
+void renderOnPlaylist() {
+  Playlist& currentPlaylist = state.playlists[state.currentPlaylist];
+
+  // Downloaded tracks are added to the playlist while the download of this playlist runs
+  bool syncing = state.playlistDownloadRunning && 
+    std::filesystem::path(currentPlaylist.path).filename().string() == state.downloadingPlaylistName;
 
   // Playlist Heading
   {
@@ -1457,15 +1478,23 @@ void renderOnPlaylist() {
 
     { 
       lf_next_line();
-      if(renderMenuBarElement("Sync Downloads", state.icons["sync"].id)) {
-        terminateAudio();
-        system(std::string(LYSSA_DIR + "/scripts/download.sh \"" + currentPlaylist.url + "\" " + LYSSA_DIR + "/downloaded_playlists/ &").c_str());
-
-        state.playlistDownloadRunning = true;
+      // A running probe of the Download tab would be cancelled by the one of the sync
+      bool syncClicked = renderMenuBarElement("Sync Downloads", state.icons["sync"].id);
+      if(syncClicked && DownloadManager::isProbing()) {
+        state.infoCards.addCard("Wait until the playlist is fetched.");
+      } else if(syncClicked && !state.playlistDownloadRunning) {
+        uint32_t playlistIndex = state.currentPlaylist;
         state.downloadingPlaylistName = std::filesystem::path(currentPlaylist.path).filename().string();
-        state.downloadPlaylistFileCount = LyssaUtils::getPlaylistFileCountURL(currentPlaylist.url);
-
-        clearedPlaylist = false;
+        // Set before syncing, the finish callback can run right away if the probe fails to spawn
+        state.playlistDownloadRunning = true;
+        // Only the entries that are new since the last sync get downloaded and appended
+        DownloadManager::sync(currentPlaylist.url, LYSSA_DIR + "/downloaded_playlists/" + state.downloadingPlaylistName,
+            PLAYLIST_SYNC_PRUNE_REMOVED,
+            [playlistIndex](const DownloadItem& item){
+            if(!item.path.empty()) addFileToPlaylistAsync(item.path, playlistIndex);
+            },
+            [playlistIndex](const std::string& path){ removeFileFromPlaylist(path, playlistIndex); },
+            [](){ finishPlaylistSync(); });
       }
       if(renderMenuBarElement("Search", state.icons["search"].id)) {
         state.searchPlaylistResults.clear();
@@ -1473,18 +1502,18 @@ void renderOnPlaylist() {
         changeTabTo(GuiTab::SearchPlaylist);
       }
       if(renderMenuBarElement("Jump to top", state.icons["jump_to_top"].id)) {
-        float filePosY = currentPlaylist.musicFiles[0].renderPosY;
+        float filePosY = currentPlaylist.getFileRenderPosY(0);
         currentPlaylist.scroll = -filePosY;
       }
       if(renderMenuBarElement("Jump to bottom", state.icons["jump_to_bottom"].id)) {
-        float filePosY = currentPlaylist.musicFiles[currentPlaylist.musicFiles.size() - 1].renderPosY;
+        float filePosY = currentPlaylist.getFileRenderPosY(currentPlaylist.musicFiles.size() - 1);
         currentPlaylist.scroll = -filePosY;
       }
       lf_set_ptr_y_absolute(lf_get_ptr_y() + 60.0f);
     }
   }
 
-  if(state.playlistDownloadRunning) {
+  if(syncing && currentPlaylist.musicFiles.empty()) {
     lf_set_ptr_y(100);
     lf_push_font(&state.h5Font);
     const char* text = "Syncing playlist downloads...";
@@ -1503,8 +1532,8 @@ void renderOnPlaylist() {
     lf_pop_font();
     lf_next_line();
     {
-        std::string downloadedPlaylistDir = LYSSA_DIR + "/downloaded_playlists/" + state.downloadingPlaylistName; 
-        uint32_t downloadedFileCount = MIN(LyssaUtils::getLineCountFile(downloadedPlaylistDir + "/archive.txt"), state.downloadPlaylistFileCount);
+        uint32_t downloadedFileCount = DownloadManager::getCount(DownloadStatus::Finished);
+        uint32_t fileCount = DownloadManager::getItems().size();
         const vec2s progressBarSize = (vec2s){400, 6};
 
         LfUIElementProps props = lf_get_theme().slider_props;
@@ -1532,11 +1561,11 @@ void renderOnPlaylist() {
         }
 
         lf_push_style_props(props);
-        lf_progress_bar_int(downloadedFileCount, 0, (float)state.downloadPlaylistFileCount, progressBarSize.x, progressBarSize.y);
+        lf_progress_bar_int(downloadedFileCount, 0, (float)(MAX(fileCount, 1)), progressBarSize.x, progressBarSize.y);
         lf_pop_style_props();
 
         {
-            std::string totalFileCount = std::to_string(state.downloadPlaylistFileCount);
+            std::string totalFileCount = std::to_string(fileCount);
             static float totalFileCountHeight = lf_text_dimension(totalFileCount.c_str()).y;
 
             LfUIElementProps props = lf_get_theme().text_props;
@@ -1550,6 +1579,8 @@ void renderOnPlaylist() {
             lf_pop_font();
         }
     }
+    lf_next_line();
+    renderDownloadItems();
   } else if(currentPlaylist.musicFiles.empty()) {
       lf_next_line();
     // Text
@@ -1599,7 +1630,7 @@ void renderOnPlaylist() {
               if(state.soundHandler.isInit) {
                   state.soundHandler.stop();
                   state.soundHandler.uninit();
-                  state.currentSoundFile = nullptr;
+                  state.currentTrack = INVALID_TRACK_ID;
               }
               changeTabTo(GuiTab::PlaylistAddFromFolder);
           }
@@ -1641,6 +1672,20 @@ void renderOnPlaylist() {
   } else {
     lf_next_line();
 
+    if(syncing) {
+      LfUIElementProps props = lf_get_theme().text_props;
+      props.text_color = lf_color_brightness(GRAY, 1.5);
+      props.margin_bottom = 10;
+      lf_push_style_props(props);
+      lf_push_font(&state.h6Font);
+      std::string text = "Syncing playlist downloads... " + 
+        std::to_string(DownloadManager::getCount(DownloadStatus::Finished)) + " of " + 
+        std::to_string(DownloadManager::getItems().size()) + " files";
+      lf_text(text.c_str());
+      lf_pop_font();
+      lf_pop_style_props();
+      lf_next_line();
+    }
 
     /* Heading */
     {
@@ -1687,17 +1732,35 @@ void renderOnPlaylist() {
     static bool draggingTrack = false;
     static std::string draggingTrackTitle = "";
     static int32_t draggingTrackIndex = -1;
-    for(uint32_t i = 0; i < currentPlaylist.musicFiles.size(); i++) {
-      SoundFile& file = currentPlaylist.musicFiles[i];
+
+    // All rows have the same height, so only the rows inside the div (plus some overscan)
+    // get rendered and the pointer is moved over the others.
+    uint32_t fileCount = currentPlaylist.musicFiles.size();
+    float listStartY = lf_get_ptr_y();
+    float rowHeight = currentPlaylist.fileRowHeight != 0.0f ? currentPlaylist.fileRowHeight : PLAYLIST_FILE_THUMBNAIL_SIZE.y + 10.0f;
+    LfAABB listDivAABB = lf_get_current_div().aabb;
+    currentPlaylist.filesStartY = (listStartY - currentPlaylist.scroll) - listDivAABB.size.y;
+
+    int32_t firstVisible = (int32_t)floorf((listDivAABB.pos.y - listStartY) / rowHeight) - PLAYLIST_FILE_OVERSCAN_ROWS;
+    int32_t lastVisible = (int32_t)ceilf((listDivAABB.pos.y + listDivAABB.size.y - listStartY) / rowHeight) + PLAYLIST_FILE_OVERSCAN_ROWS;
+    uint32_t firstRow = (uint32_t)std::max(firstVisible, 0);
+    uint32_t endRow = (uint32_t)std::clamp(lastVisible, 0, (int32_t)fileCount);
+    if(firstRow > endRow) firstRow = endRow;
+
+    lf_set_ptr_y_absolute(listStartY + firstRow * rowHeight);
+    for(uint32_t i = firstRow; i < endRow; i++) {
+      TrackId trackId = currentPlaylist.musicFiles[i];
+      std::filesystem::path filepath = TrackLibrary::getPath(trackId);
       bool onActionButton = false;
+      if(!state.unboostedFileLoads.empty()) {
+        boostPlaylistFileLoading(trackId);
+      }
       {
         vec2s thumbnailContainerSize = PLAYLIST_FILE_THUMBNAIL_SIZE;
         vec2s startPtr= LF_PTR;
 
         float marginBottomThumbnail = 10.0f, marginTopThumbnail = 5.0f;
 
-        file.renderPosY = (lf_get_ptr_y() - currentPlaylist.scroll) - lf_get_current_div().aabb.size.y;
-
         LfAABB fileAABB = (LfAABB){
           .pos = (vec2s){lf_get_ptr_x(), lf_get_ptr_y()},
             .size = (vec2s){(float)state.win->getWidth() - DIV_START_X * 2, (float)thumbnailContainerSize.y + marginBottomThumbnail}
@@ -1708,7 +1771,7 @@ void renderOnPlaylist() {
           currentPlaylist.selectedFile = (int32_t)i;
         }
         if(hoveredTextDiv && lf_mouse_button_is_released(GLFW_MOUSE_BUTTON_RIGHT)) {
-          state.popups[PopupType::PlaylistFileDialoguePopup] = std::make_unique<PlaylistFileDialoguePopup>(file.path, 
+          state.popups[PopupType::PlaylistFileDialoguePopup] = std::make_unique<PlaylistFileDialoguePopup>(filepath, 
                   (vec2s){(float)lf_get_mouse_x() + 10, (float)lf_get_mouse_y() + 10});
           state.popups[PopupType::PlaylistFileDialoguePopup]->shouldRender = true;
         }
@@ -1727,7 +1790,7 @@ void renderOnPlaylist() {
           LfClickableItemState state = lf_image_button(((LfTexture){.id = id, .width = 25, .height = 7}));
 
           if(lf_mouse_button_went_down(GLFW_MOUSE_BUTTON_LEFT) && state != LF_IDLE) {
-            draggingTrackTitle = file.title;
+            draggingTrackTitle = TrackLibrary::getTitle(trackId);
             draggingTrackIndex = i;
           } 
           if(!draggingTrack && draggingTrackTitle != "" && (fabsf(lf_get_mouse_x_delta()) > 2 || fabsf(lf_get_mouse_y_delta()) > 2)) {
@@ -1746,7 +1809,7 @@ void renderOnPlaylist() {
             bool hoveredPlayButton = lf_hovered((vec2s){indexPos.x - 5, indexPos.y}, 
                 (vec2s){(float)lf_get_theme().font.font_size, (float)lf_get_theme().font.font_size}); 
             onActionButton = hoveredPlayButton;
-            if(hoveredTextDiv && lf_mouse_button_is_released(GLFW_MOUSE_BUTTON_LEFT) && onActionButton && state.playlistFileFutures.empty()) {
+            if(hoveredTextDiv && lf_mouse_button_is_released(GLFW_MOUSE_BUTTON_LEFT) && onActionButton) {
               if(currentPlaylist.playingFile == i) {
                 if(state.soundHandler.isPlaying)
                   state.soundHandler.stop();
@@ -1754,7 +1817,7 @@ void renderOnPlaylist() {
                   state.soundHandler.play();
               } else {
                 playlistPlayFileWithIndex(i, state.currentPlaylist);
-                state.currentSoundFile = &file;
+                state.currentTrack = trackId;
               }
             }
             lf_image_render((vec2s){indexPos.x - 2.5f, indexPos.y}, LF_WHITE, 
@@ -1770,21 +1833,21 @@ void renderOnPlaylist() {
         // Thumbnail + Title
         {
           lf_set_ptr_y_absolute(lf_get_ptr_y() + marginTopThumbnail);
-          LfClickableItemState thumbnailState = renderSoundFileThumbnail(thumbnailContainerSize, file, nullptr, false);
+          LfClickableItemState thumbnailState = renderSoundFileThumbnail(thumbnailContainerSize, trackId, nullptr, false);
 
           if(thumbnailState == LF_CLICKED && i != currentPlaylist.playingFile) {
-            state.currentSoundFile = &file;
+            state.currentTrack = trackId;
             if(state.onTrackTab.trackThumbnail.width != 0) {
               lf_free_texture(&state.onTrackTab.trackThumbnail);
             }
-            state.onTrackTab.trackThumbnail = SoundTagParser::getSoundThubmnail(state.currentSoundFile->path, (vec2s){-1, -1});
+            state.onTrackTab.trackThumbnail = SoundTagParser::getSoundThubmnail(TrackLibrary::getPath(state.currentTrack), (vec2s){-1, -1});
             changeTabTo(GuiTab::OnTrack);
             playlistPlayFileWithIndex(i, state.currentPlaylist);
           } else if(thumbnailState == LF_CLICKED && i == currentPlaylist.playingFile) {
             if(state.onTrackTab.trackThumbnail.width != 0) {
               lf_free_texture(&state.onTrackTab.trackThumbnail);
             }
-            state.onTrackTab.trackThumbnail = SoundTagParser::getSoundThubmnail(state.currentSoundFile->path, (vec2s){-1, -1});
+            state.onTrackTab.trackThumbnail = SoundTagParser::getSoundThubmnail(TrackLibrary::getPath(state.currentTrack), (vec2s){-1, -1});
             changeTabTo(GuiTab::OnTrack);
           }
          
@@ -1793,8 +1856,9 @@ void renderOnPlaylist() {
           }
           lf_set_line_height(thumbnailContainerSize.y + marginBottomThumbnail);
 
-          std::filesystem::path fsPath(file.path);
-          std::string filename = file.title == "" ? removeFileExtensionW(fsPath.filename().string()) : file.title;
+          const char* title = TrackLibrary::getTitle(trackId);
+          const char* artist = TrackLibrary::getArtist(trackId);
+          std::string filename = title[0] == '\0' ? removeFileExtensionW(filepath.filename().string()) : title;
 
 
           /* Title */
@@ -1804,7 +1868,7 @@ void renderOnPlaylist() {
 
           renderTextRaw((vec2s){lf_get_ptr_x(), lf_get_ptr_y() + marginTopThumbnail}, filename.c_str(), state.h6BoldFont, 
               (currentPlaylist.selectedFile == i ? lf_color_brightness(LF_WHITE, 0.7f) : LF_WHITE), -1);
-          renderTextRaw((vec2s){lf_get_ptr_x(), lf_get_ptr_y() + marginTopThumbnail + state.h6Font.font_size}, file.artist.empty() ? "-" : file.artist.c_str(), state.h5Font,
+          renderTextRaw((vec2s){lf_get_ptr_x(), lf_get_ptr_y() + marginTopThumbnail + state.h6Font.font_size}, artist[0] == '\0' ? "-" : artist, state.h5Font,
               lf_color_brightness(GRAY, 1.4f));
 
           lf_unset_cull_end_x();
@@ -1817,15 +1881,16 @@ void renderOnPlaylist() {
           props.text_color = lf_color_brightness(GRAY, 1.6f);
           props.margin_left = 0;
           props.margin_right = 0;
-          props.margin_top = (thumbnailContainerSize.y - lf_text_dimension(std::to_string(file.releaseYear).c_str()).y) / 2.0f;
+          uint32_t releaseYear = TrackLibrary::getReleaseYear(trackId);
+          props.margin_top = (thumbnailContainerSize.y - lf_text_dimension(std::to_string(releaseYear).c_str()).y) / 2.0f;
           lf_push_style_props(props);
-          if(file.releaseYear != 0)
-            lf_text(std::to_string(file.releaseYear).c_str());
+          if(releaseYear != 0)
+            lf_text(std::to_string(releaseYear).c_str());
           else 
             lf_text("-");
           lf_pop_style_props();
           // 0th playlist index is favourites
-          if((Playlist::containsFile(file.path, 0) || Playlist::metadataContainsFile(file.path, 0)) && state.currentPlaylist != 0)
+          if(Playlist::containsFile(filepath, 0) && state.currentPlaylist != 0)
           {
               LfUIElementProps props = lf_get_theme().button_props;
               props.border_width = 0.0f;
@@ -1842,15 +1907,13 @@ void renderOnPlaylist() {
           }
         }
 
-        if(lf_mouse_button_is_released(GLFW_MOUSE_BUTTON_LEFT) && hoveredTextDiv && !onActionButton && state.playlistFileFutures.empty()) {
+        if(lf_mouse_button_is_released(GLFW_MOUSE_BUTTON_LEFT) && hoveredTextDiv && !onActionButton) {
           if(!draggingTrack) {
             playlistPlayFileWithIndex(i, state.currentPlaylist);
-            state.currentSoundFile = &file;
+            state.currentTrack = trackId;
           } else {
-            if(state.currentSoundFile) {
-              if(*state.currentSoundFile == currentPlaylist.musicFiles[draggingTrackIndex]) {
-                terminateAudio();
-              }
+            if(state.currentTrack == currentPlaylist.musicFiles[draggingTrackIndex]) {
+              terminateAudio();
             }
             moveFileInPlaylistIdx(state.currentPlaylist, draggingTrackIndex, i);
             draggingTrack = false;
@@ -1862,12 +1925,12 @@ void renderOnPlaylist() {
         {
           lf_set_ptr_x((state.win->getWidth() - state.sideNavigationWidth) - (lf_text_dimension("Duration").x) -  DIV_START_X * 2 - lf_get_theme().text_props.margin_left);
           LfUIElementProps props = lf_get_theme().text_props;
-          std::string durationText = formatDurationToMins(file.duration);
+          std::string durationText = formatDurationToMins(TrackLibrary::getDuration(trackId));
           props.margin_top = (thumbnailContainerSize.y - lf_text_dimension(durationText.c_str()).y) / 2.0f;
           lf_push_style_props(props);
           LfClickableItemState durationState = lf_button(durationText.c_str());
           if(lf_mouse_button_went_down(GLFW_MOUSE_BUTTON_LEFT) && durationState != LF_IDLE) {
-            draggingTrackTitle = file.title;
+            draggingTrackTitle = TrackLibrary::getTitle(trackId);
             draggingTrackIndex = i;
           } 
           if(!draggingTrack && draggingTrackTitle != "" && (fabsf(lf_get_mouse_x_delta()) > 2 || fabsf(lf_get_mouse_y_delta()) > 2)) {
@@ -1883,8 +1946,13 @@ void renderOnPlaylist() {
           draggingTrackTitle = "";
         }
         lf_next_line(); 
+        if(i == firstRow) {
+          currentPlaylist.fileRowHeight = lf_get_ptr_y() - startPtr.y;
+        }
       }
     }
+    // The skipped rows below still count for the scrollable area
+    lf_set_ptr_y_absolute(listStartY + fileCount * rowHeight);
     lf_div_end();
     if(draggingTrack) {
       LfUIElementProps props = lf_get_theme().div_props;
@@ -1901,21 +1969,19 @@ void renderOnPlaylist() {
     }
   }
 
-  if(state.playlistFileFutures.empty()) {
-    beginBottomNavBar();
-    backButtonTo(GuiTab::Dashboard, [&](){
-        if(state.dashboardTab == DashboardTab::Favourites) {
-          state.dashboardTab = DashboardTab::Home;
-        }
-        loadPlaylists();
-        });
-    renderTrackMenu();
-    lf_div_end();
-  }
+  beginBottomNavBar();
+  backButtonTo(GuiTab::Dashboard, [&](){
+      if(state.dashboardTab == DashboardTab::Favourites) {
+        state.dashboardTab = DashboardTab::Home;
+      }
+      loadPlaylists();
+      });
+  renderTrackMenu();
+  lf_div_end();
 }
 void renderOnTrack() {
-  if(!state.currentSoundFile) return;
-  SoundFile* soundFile = state.currentSoundFile;
+  if(state.currentTrack == INVALID_TRACK_ID) return;
+  TrackId trackId = state.currentTrack;
 
   int32_t winWidth = state.win->getWidth();
   int32_t winHeight = state.win->getHeight();
@@ -1978,8 +2044,8 @@ void renderOnTrack() {
 
   // Title
   {
-    std::string filename = soundFile->title == "" ? 
-      removeFileExtensionW(soundFile->path.filename().string()) : soundFile->title;
+    std::string filename = TrackLibrary::getTitle(trackId);
+    if(filename.empty()) filename = removeFileExtensionW(TrackLibrary::getPath(trackId).filename().string());
 
     float textWidth = lf_text_dimension(filename.c_str()).x; 
     if(textWidth > containerSize) {
@@ -1997,7 +2063,8 @@ void renderOnTrack() {
 
   // Arist
   {
-    std::string artist = soundFile->artist == "" ? "-" : soundFile->artist;
+    std::string artist = TrackLibrary::getArtist(trackId);
+    if(artist.empty()) artist = "-";
 
     float textWidth = lf_text_dimension(artist.c_str()).x; 
     lf_set_ptr_x_absolute((winWidth - textWidth) / 2.0f);
@@ -2011,7 +2078,7 @@ void renderOnTrack() {
   {
     lf_set_ptr_x_absolute((winWidth - containerSize) / 2.0f);
     lf_push_font(&state.h6Font);
-    std::string durationMins = formatDurationToMins(state.soundHandler.getPositionInSeconds());
+    std::string durationMins = formatDurationToMins(state.currentSoundPos);
     LfUIElementProps props = lf_get_theme().text_props;
     props.margin_top = 15.0f;
     props.margin_left = 0.0f;
@@ -2208,7 +2275,7 @@ void renderTrackFullscreen() {
 
 
   if(state.trackFullscreenTab.showUI) {
-    renderTextRaw((vec2s){DIV_START_X, DIV_START_Y}, state.currentSoundFile->title.c_str(), lf_get_theme().font, LF_WHITE);
+    renderTextRaw((vec2s){DIV_START_X, DIV_START_Y}, TrackLibrary::getTitle(state.currentTrack), lf_get_theme().font, LF_WHITE);
     lf_div_end();
     lf_div_begin(((vec2s){DIV_START_X, state.win->getHeight() - BACK_BUTTON_HEIGHT - 45 - DIV_START_Y * 2}), ((vec2s){(float)state.win->getWidth(), BACK_BUTTON_HEIGHT + 45 + DIV_START_Y * 2}),
         false);
@@ -2308,22 +2375,18 @@ static void renderTopBarAddFromFolder() {
   lf_push_style_props(props);
   LfClickableItemState addAllButton = lf_button("Add All");
   if(addAllButton == LF_CLICKED) {
-    if(!state.playlistFileThumbnailData.empty()) {
-      state.playlistFileThumbnailData.clear();
-    }
     state.playlistAddFromFolderTab.addedFile = true;
     Playlist& currentPlaylist = state.playlists[state.currentPlaylist];
-    std::ofstream metadata(currentPlaylist.path.string() + "/.metadata", std::ios::app);
-    metadata.seekp(0, std::ios::end);
+    std::vector<std::string> paths;
     for(const auto& entry : tab.folderContents) {
       if(!entry.is_directory() && 
           !Playlist::metadataContainsFile(entry.path().string(), state.currentPlaylist) && 
           SoundTagParser::isValidSoundFile(entry.path().string())) {
-        metadata << "\"" << entry.path().string() << "\" ";
+        paths.emplace_back(entry.path().string());
         state.loadedPlaylistFilepaths.push_back(entry.path().string());
       }
     }
-    metadata.close();
+    PlaylistMetadata::appendFiles(currentPlaylist.path, paths);
   }
   lf_pop_style_props();
 }
@@ -2379,9 +2442,7 @@ void renderPlaylistAddFromFolder() {
       if(lf_image_button(icon) == LF_CLICKED && !entry.is_directory() && 
           !Playlist::metadataContainsFile(entry.path().string(), state.currentPlaylist) && 
           SoundTagParser::isValidSoundFile(entry.path().string())) {
-        std::ofstream metadata(state.playlists[state.currentPlaylist].path.string() + "/.metadata", std::ios::app);
-        metadata.seekp(0, std::ios::end);
-        metadata << "\"" << entry.path().string() << "\" ";
+        PlaylistMetadata::appendFile(state.playlists[state.currentPlaylist].path, entry.path().string());
         state.loadedPlaylistFilepaths.push_back(entry.path().string());
         state.playlistAddFromFolderTab.addedFile = true;
       }
@@ -2398,11 +2459,11 @@ void renderPlaylistAddFromFolder() {
       if(state.soundHandler.isInit) {
       state.soundHandler.stop();
       state.soundHandler.uninit();
-      state.currentSoundFile = nullptr;
+      state.currentTrack = INVALID_TRACK_ID;
       }
       Playlist& playlist = state.playlists[state.currentPlaylist];
 
-      playlist.musicFiles.clear();
+      Playlist::clearFiles(state.currentPlaylist);
       playlist.musicFiles.shrink_to_fit();
       state.loadedPlaylistFilepaths.clear();
       state.loadedPlaylistFilepaths.shrink_to_fit();
@@ -2447,19 +2508,8 @@ static void renderPlaylistSetThumbnail() {
             state.createPlaylistTab.thumbnailPath = entry.path().string();
           else if(state.previousTab == GuiTab::Dashboard) {
             Playlist& currentPlaylist = state.playlists[state.currentPlaylist]; 
-            currentPlaylist.thumbnailPath = entry.path().string();
             currentPlaylist.thumbnail = lf_load_texture(entry.path().string().c_str(), false, LF_TEX_FILTER_LINEAR); 
-            bool playlistEmpty = currentPlaylist.musicFiles.empty();
-            if(playlistEmpty) {
-              for(auto& filepath : PlaylistMetadata::getFilepaths(std::filesystem::directory_entry(currentPlaylist.path))) {
-                currentPlaylist.musicFiles.emplace_back((SoundFile){.path = filepath});
-              }
-            }
-            Playlist::save(state.currentPlaylist);
-            if(playlistEmpty) {
-              currentPlaylist.musicFiles.clear();
-              currentPlaylist.musicFiles.shrink_to_fit();
-            }
+            Playlist::changeThumbnail(entry.path(), state.currentPlaylist);
           }
           changeTabTo(state.previousTab);
         }
@@ -2496,7 +2546,7 @@ void renderSearchPlaylist() {
 
   lf_next_line();
   bool clickedThumbnail = false;
-  SoundFile clickedSoundFile;
+  std::filesystem::path clickedSoundPath;
   if (!state.searchPlaylistResults.empty()) {
     lf_div_begin(LF_PTR, ((vec2s){(float)state.win->getWidth() - DIV_START_X * 2 - state.sideNavigationWidth, 
           (float)state.win->getHeight() - DIV_START_Y * 2 - lf_get_ptr_y() - 
@@ -2508,23 +2558,24 @@ void renderSearchPlaylist() {
     const float ptrXStart = lf_get_ptr_x();
     const float cornerRadius = 6.0f;
 
-    uint32_t resIdx = 0;
-    for(auto& res : state.searchPlaylistResults) {
-      LfClickableItemState thumbnailState = renderSoundFileThumbnail((vec2s){size.x, size.x}, res, nullptr, true, 4.0f); 
-      if(thumbnailState == LF_CLICKED) {
-        state.currentSoundFile = &res;
+    std::vector<TrackId>& files = state.playlists[state.currentPlaylist].musicFiles;
+    for(TrackId resId : state.searchPlaylistResults) {
+      LfClickableItemState thumbnailState = renderSoundFileThumbnail((vec2s){size.x, size.x}, resId, nullptr, true, 4.0f); 
+      auto fileIt = std::find(files.begin(), files.end(), resId);
+      if(thumbnailState == LF_CLICKED && fileIt != files.end()) {
+        state.currentTrack = resId;
         if(state.onTrackTab.trackThumbnail.width != 0) {
           lf_free_texture(&state.onTrackTab.trackThumbnail);
         }
-        state.onTrackTab.trackThumbnail = SoundTagParser::getSoundThubmnail(state.currentSoundFile->path, (vec2s){-1, -1});
+        state.onTrackTab.trackThumbnail = SoundTagParser::getSoundThubmnail(TrackLibrary::getPath(state.currentTrack), (vec2s){-1, -1});
         changeTabTo(GuiTab::OnTrack);
-        playlistPlayFileWithIndex(resIdx, state.currentPlaylist);
+        playlistPlayFileWithIndex(std::distance(files.begin(), fileIt), state.currentPlaylist);
       }
       lf_set_cull_end_x(lf_get_ptr_x());
-      renderTextRaw((vec2s){lf_get_ptr_x() - size.x, lf_get_ptr_y() + size.x + (margin / 3.0f)}, res.title.c_str(),
+      renderTextRaw((vec2s){lf_get_ptr_x() - size.x, lf_get_ptr_y() + size.x + (margin / 3.0f)}, TrackLibrary::getTitle(resId),
           state.h6Font, LF_WHITE);
 
-      renderTextRaw((vec2s){lf_get_ptr_x() - size.x, lf_get_ptr_y() + size.x + state.h6Font.font_size + (margin / 3.0f)}, res.artist.c_str(),
+      renderTextRaw((vec2s){lf_get_ptr_x() - size.x, lf_get_ptr_y() + size.x + state.h6Font.font_size + (margin / 3.0f)}, TrackLibrary::getArtist(resId),
           state.h6Font, lf_color_brightness(GRAY, 1.4f));
       lf_unset_cull_end_x();
 
@@ -2535,9 +2586,8 @@ void renderSearchPlaylist() {
       }
       if(thumbnailState == LF_HOVERED && lf_mouse_button_is_released(GLFW_MOUSE_BUTTON_RIGHT)) {
         clickedThumbnail = true;
-        clickedSoundFile = res;
+        clickedSoundPath = TrackLibrary::getPath(resId);
       }
-      resIdx++;
     }
     lf_div_end();
     } else {
@@ -2561,7 +2611,7 @@ void renderSearchPlaylist() {
       lf_pop_style_props();
   } 
   if(clickedThumbnail) {
-    state.popups[PopupType::PlaylistFileDialoguePopup] = std::make_unique<PlaylistFileDialoguePopup>(clickedSoundFile.path, 
+    state.popups[PopupType::PlaylistFileDialoguePopup] = std::make_unique<PlaylistFileDialoguePopup>(clickedSoundPath, 
         (vec2s){(float)lf_get_mouse_x() + 10, (float)lf_get_mouse_y() + 10});
     state.popups[PopupType::PlaylistFileDialoguePopup]->shouldRender = true;
   }
@@ -2705,19 +2755,21 @@ void renderSearchAll() {
 }
 
 void renderTrackDisplay() {
-  if(state.currentSoundFile == NULL) return;
+  if(state.currentTrack == INVALID_TRACK_ID) return;
   const float margin = DIV_START_X;
   const float marginThumbnail = 15;
   const vec2s thumbnailContainerSize = PLAYLIST_FILE_THUMBNAIL_SIZE;
   const float padding = 10;
 
-  std::filesystem::path filepath = state.currentSoundFile->path;
+  std::filesystem::path filepath = TrackLibrary::getPath(state.currentTrack);
 
-  std::string filename = state.currentSoundFile->title == "" ? 
-    removeFileExtensionW(state.currentSoundFile->path.filename().string()) : state.currentSoundFile->title;
-  std::string artist = state.currentSoundFile->artist;
+  std::string filename = TrackLibrary::getTitle(state.currentTrack);
+  if(filename.empty()) filename = removeFileExtensionW(filepath.filename().string());
+  std::string artist = TrackLibrary::getArtist(state.currentTrack);
 
-  SoundFile& playingFile = state.playlists[state.playingPlaylist].musicFiles[state.playlists[state.playingPlaylist].playingFile];
+  Playlist& playingPlaylist = state.playlists[state.playingPlaylist];
+  TrackId playingTrack = playingPlaylist.playingFile >= 0 && playingPlaylist.playingFile < (int32_t)playingPlaylist.musicFiles.size() ?
+    playingPlaylist.musicFiles[playingPlaylist.playingFile] : state.currentTrack;
 
   // Container 
   float containerPosX = (float)(state.win->getWidth() - state.trackProgressSlider.width) / 2.0f + state.trackProgressSlider.width + 
@@ -2738,7 +2790,7 @@ void renderTrackDisplay() {
   {
     lf_set_ptr_x_absolute(containerPos.x + padding);
     lf_set_ptr_y_absolute(containerPos.y + padding);
-    renderSoundFileThumbnail(thumbnailContainerSize, playingFile);
+    renderSoundFileThumbnail(thumbnailContainerSize, playingTrack);
   }
   // Name + Artist
   {
@@ -2759,7 +2811,7 @@ void renderTrackDisplay() {
   }
 }
 void renderTrackProgress(bool dark) {
-  if(state.currentSoundFile == NULL) return;
+  if(state.currentTrack == INVALID_TRACK_ID) return;
   // Progress position in seconds
   state.trackProgressSlider.width = state.win->getWidth() / 2.5f;
   state.trackProgressSlider.height = 5.0f;
@@ -2768,7 +2820,7 @@ void renderTrackProgress(bool dark) {
   state.trackProgressSlider.handle_size = 15.0f;
   {
     lf_push_font(&state.h6Font);
-    std::string durationMins = formatDurationToMins(state.soundHandler.getPositionInSeconds());
+    std::string durationMins = formatDurationToMins(state.currentSoundPos);
     lf_set_ptr_x_absolute((state.win->getWidth() - state.trackProgressSlider.width) / 2.0f - lf_text_dimension(durationMins.c_str()).x - 15);
     LfUIElementProps props = lf_get_theme().text_props;
     props.margin_top = 55.0f;
@@ -2991,94 +3043,260 @@ void backButtonTo(GuiTab tab, const std::function<void()>& clickCb ) {
 }
 
 void loadPlaylists() {
-  uint32_t playlistI = 0;
-
-  if(std::find(state.playlists.begin(), state.playlists.end(), (Playlist){.path = LYSSA_DIR + "/playlists/favourites"}) == state.playlists.end()) {
-    std::string favouritesDir = LYSSA_DIR + "/playlists/favourites";
-    Playlist favourites;
-    favourites.path = favouritesDir;
-    favourites.name = PlaylistMetadata::getName(std::filesystem::directory_entry(favouritesDir));
-    favourites.desc = PlaylistMetadata::getDesc(std::filesystem::directory_entry(favouritesDir));
-    favourites.url = "";
-    favourites.thumbnailPath = "";
-    state.playlists.emplace_back(favourites);
-  }
+  // Favourites always come first
+  std::vector<std::filesystem::path> playlistDirs;
+  std::string favouritesDir = LYSSA_DIR + "/playlists/favourites";
+  if(std::find(state.playlists.begin(), state.playlists.end(), (Playlist){.path = favouritesDir}) == state.playlists.end()) 
+    playlistDirs.emplace_back(favouritesDir);
 
   for (const auto& folder : std::filesystem::directory_iterator(LYSSA_DIR + "/playlists/")) {
     if(folder.path().filename() == "favourites") continue;
+    if(std::find(state.playlists.begin(), state.playlists.end(), (Playlist){.path = folder.path()}) != state.playlists.end()) continue;
+    playlistDirs.emplace_back(folder.path());
+  }
+
+  // One read of the header per playlist, all of them in parallel. The paths are only read once it is opened.
+  std::vector<PlaylistHeader> headers(playlistDirs.size());
+  std::shared_ptr<JobGroup> headerJobs = std::make_shared<JobGroup>();
+  for(uint32_t i = 0; i < playlistDirs.size(); i++) {
+    state.jobSystem.submit([&playlistDirs, &headers, i](){
+        PlaylistMetadata::readHeader(playlistDirs[i], headers[i]);
+        }, JobPriority::High, headerJobs);
+  }
+  headerJobs->wait();
+
+  for(uint32_t i = 0; i < playlistDirs.size(); i++) {
     Playlist playlist{};
-    playlist.path = folder.path().string();
-    playlist.name = PlaylistMetadata::getName(folder);
-    playlist.desc = PlaylistMetadata::getDesc(folder);
-    playlist.url = PlaylistMetadata::getUrl(folder);
-    playlist.thumbnailPath = PlaylistMetadata::getThumbnailPath(folder);
-    if(std::find(state.playlists.begin(), state.playlists.end(), playlist) == state.playlists.end()) {
-      if(playlist.thumbnailPath != "") {
-        playlist.thumbnail = lf_load_texture_resized(playlist.thumbnailPath.string().c_str(), false, LF_TEX_FILTER_LINEAR, 180, 180);
-      }
-      state.playlists.emplace_back(playlist);
+    playlist.path = playlistDirs[i];
+    playlist.name = headers[i].name;
+    playlist.desc = headers[i].desc;
+    if(playlistDirs[i] != favouritesDir) {
+      playlist.url = headers[i].url;
+      playlist.thumbnailPath = headers[i].thumbnailPath;
     }
+    state.playlists.emplace_back(playlist);
+    loadPlaylistCoverAsync(playlist);
   }
 }
 
-void loadPlaylistFileAsync(std::vector<SoundFile>* files, std::string path) {
-  std::lock_guard<std::mutex> lock(state.mutex);
-  SoundFile file{};
-  if(std::filesystem::exists(path)) {
-    file.path = std::filesystem::path(path); 
-    file.thumbnail = (LfTexture){0};
-    file.duration = SoundTagParser::getSoundDuration(path);
-    file.artist = SoundTagParser::getSoundArtist(path);
-    file.title = SoundTagParser::getSoundTitle(path);
-    file.releaseYear = SoundTagParser::getSoundReleaseYear(path);
-  } else {
-    file.path = "File cannot be loaded";
-    file.thumbnail = (LfTexture){0};
+void loadPlaylistCoverAsync(const Playlist& playlist) {
+  if(playlist.thumbnailPath.empty()) return;
+  std::filesystem::path playlistPath = playlist.path, thumbnailPath = playlist.thumbnailPath;
+  state.jobSystem.submit([playlistPath, thumbnailPath](){
+      state.decodedCovers.push((DecodedCover){
+          .playlistPath = playlistPath, 
+          .pixels = ThumbnailCache::getCoverData(thumbnailPath)
+          });
+      }, JobPriority::Normal);
+}
+
+void handleDecodedCovers() {
+  state.decodedCovers.drain([](DecodedCover&& cover){
+      auto it = std::find(state.playlists.begin(), state.playlists.end(), (Playlist){.path = cover.playlistPath});
+      if(it == state.playlists.end() || !cover.pixels.data) {
+        free(cover.pixels.data);
+        return;
+      }
+      if(it->thumbnail.width != 0) {
+        lf_free_texture(&it->thumbnail);
+      }
+      lf_create_texture_from_image_data(LF_TEX_FILTER_LINEAR, &it->thumbnail.id, 
+          cover.pixels.width, cover.pixels.height, cover.pixels.channels, cover.pixels.data);
+      it->thumbnail.width = cover.pixels.width;
+      it->thumbnail.height = cover.pixels.height;
+      free(cover.pixels.data);
+      });
+}
+
+// Runs on a worker of the job system, touches no shared state besides the metadata cache.
+// The artwork is only decoded once the row becomes visible.
+static void loadSoundFile(const std::string& path, SoundFile& file) {
+  file.path = std::filesystem::path(path); 
+  file.stamp = TrackLibrary::readStamp(file.path);
+  if(!std::filesystem::exists(path)) {
+    file.title = "File cannot be loaded";
     file.duration = 0; 
+    return;
   }
-  files->emplace_back(file);
-  if(std::filesystem::exists(path)) {
-    state.playlistFileThumbnailData.emplace_back(SoundTagParser::getSoundThubmnailData(path, PLAYLIST_FILE_THUMBNAIL_SIZE));
-  } else {
-    state.playlistFileThumbnailData.emplace_back((TextureData){0});
-  }
+  SoundTags tags = MetadataCache::getTags(path, false);
+  file.duration = static_cast<int32_t>(tags.duration);
+  file.artist = tags.artist;
+  file.title = tags.title;
+  file.releaseYear = tags.releaseYear;
+  file.artworkHash = tags.artworkHash;
 }
 
-void addFileToPlaylistAsync(std::vector<SoundFile>* files, std::string path, uint32_t playlistIndex) {
-  std::lock_guard<std::mutex> lock(state.mutex);
-  Playlist& playlist = state.playlists[playlistIndex];
+void loadPlaylistFileAsync(TrackId trackId, std::string path) {
+  LoadedSoundFile loaded{};
+  loaded.trackId = trackId;
+  loadSoundFile(path, loaded.file);
+  state.loadedPlaylistFiles.push(std::move(loaded));
+}
 
-  std::ofstream metadata(playlist.path.string() + "/.metadata", std::ios::app);
+// Loads the track again if its file changed since 'stamp', e.g. it was retagged or a failed load
+// got its file back through a download
+void refreshPlaylistFileAsync(TrackId trackId, std::string path, FileStamp stamp) {
+  if(TrackLibrary::readStamp(path) == stamp) return;
+  loadPlaylistFileAsync(trackId, path);
+}
 
-  if(!metadata.is_open()) return;
+// Loads the track of a row that scrolled into view before the rows that are not visible
+void boostPlaylistFileLoading(TrackId trackId) {
+  auto it = state.unboostedFileLoads.find(trackId);
+  if(it == state.unboostedFileLoads.end()) return;
+  std::shared_ptr<std::atomic<bool>> claim = it->second;
+  state.unboostedFileLoads.erase(it);
+  if(claim->load() || !state.playlistFileJobs) return;
+
+  std::string path = TrackLibrary::getPath(trackId);
+  state.jobSystem.submit([trackId, path, claim](){
+      if(!claim->exchange(true)) loadPlaylistFileAsync(trackId, path);
+      }, JobPriority::High, state.playlistFileJobs);
+}
+
+bool appendFileToPlaylistMetadata(const std::string& path, uint32_t playlistIndex) {
+  Playlist& playlist = state.playlists[playlistIndex];
 
   std::ifstream playlistFile(path);
-  if(!playlistFile.good()) return;
-
-  metadata << std::string("\"" + path + "\" ");
-  metadata.close();
-
-  SoundFile file{};
-  if(std::filesystem::exists(path)) {
-    file.path = std::filesystem::path(path); 
-    file.thumbnail = (LfTexture){0};
-    file.duration = SoundTagParser::getSoundDuration(path);
-    file.artist = SoundTagParser::getSoundArtist(path);
-    file.title = SoundTagParser::getSoundTitle(path);
-    file.releaseYear = SoundTagParser::getSoundReleaseYear(path);
-  } else {
-    file.path = "File cannot be loaded";
-    file.thumbnail = (LfTexture){0};
-    file.duration = 0; 
+  if(!playlistFile.good()) return false;
+
+  return PlaylistMetadata::appendFile(playlist.path, path);
+}
+
+void startPlaylistDownload(const std::string& url, const std::string& name, const PlaylistInfo& info) {
+  state.downloadingPlaylistName = name;
+  std::string downloadedPlaylistDir = LYSSA_DIR + "/downloaded_playlists/" + name; 
+  std::string playlistDir = LYSSA_DIR + "/playlists/" + name; 
+
+  // The playlist exists from the start, so every track can be added the moment it is downloaded
+  FileStatus createStatus = Playlist::create(name, "Downloaded Playlist", url);
+  loadPlaylists();
+  auto it = std::find(state.playlists.begin(), state.playlists.end(), (Playlist){.path = playlistDir});
+  if(createStatus == FileStatus::Success && it != state.playlists.end() && std::filesystem::exists(downloadedPlaylistDir)) {
+    // Tracks of an earlier download are in the archive and will not be downloaded again
+    uint32_t playlistIndex = std::distance(state.playlists.begin(), it);
+    for (const auto& entry : std::filesystem::directory_iterator(downloadedPlaylistDir)) {
+      if (entry.is_regular_file() && entry.path().extension() == ".mp3") {
+        addFileToPlaylistAsync(entry.path().string(), playlistIndex);
+      }
+    }
   }
-  files->emplace_back(file);
-  if(std::filesystem::exists(path)) {
-    state.playlistFileThumbnailData.emplace_back(SoundTagParser::getSoundThubmnailData(path, PLAYLIST_FILE_THUMBNAIL_SIZE));
+
+  // Set before starting, the finish callback runs right away if every entry is archived already
+  state.playlistDownloadRunning = true;
+  // The entries of the probe are downloaded right away, yt-dlp does not list the playlist again
+  DownloadManager::start(info, downloadedPlaylistDir, 
+      [playlistDir](const DownloadItem& item){
+      auto it = std::find(state.playlists.begin(), state.playlists.end(), (Playlist){.path = playlistDir});
+      if(it == state.playlists.end() || item.path.empty()) return;
+      addFileToPlaylistAsync(item.path, std::distance(state.playlists.begin(), it));
+      }, 
+      [url](){ finishPlaylistDownload(url); });
+}
+
+void finishPlaylistDownload(const std::string& url) {
+  // The tracks are in the playlist already, they were added as they finished
+  state.playlistDownloadRunning = false;
+  state.playlistDownloadFinished = true;
+  state.downloadPlaylistFileCount = DownloadManager::getCount(DownloadStatus::Finished);
+
+  std::string playlistDir = LYSSA_DIR + "/playlists/" + state.downloadingPlaylistName; 
+
+  ProcessManager::spawn({"yt-dlp", "--playlist-items", "1", "--skip-download", "--convert-thumbnails", "jpg", "--write-thumbnail", 
+      "-o", playlistDir + "/thumbnail.jpg", url}, [playlistDir](int32_t){
+      // The cover only needs reloading if the playlist was opened in the meantime
+      auto it = std::find(state.playlists.begin(), state.playlists.end(), (Playlist){.path = playlistDir});
+      if(it == state.playlists.end()) return;
+      loadPlaylistCoverAsync(*it);
+      });
+}
+
+void finishPlaylistSync() {
+  // The new tracks are in the playlist already, they were added as they finished
+  state.playlistDownloadRunning = false;
+  state.downloadPlaylistFileCount = DownloadManager::getCount(DownloadStatus::Finished);
+}
+
+void addFileToPlaylistAsync(const std::string& path, uint32_t playlistIndex) {
+  if(Playlist::metadataContainsFile(path, playlistIndex) || !SoundTagParser::isValidSoundFile(path)) return;
+  if(!appendFileToPlaylistMetadata(path, playlistIndex)) return;
+
+  Playlist& playlist = state.playlists[playlistIndex];
+  // A playlist that is not loaded reads the file from its playlist file once it is opened
+  if(!playlist.loaded) return;
+  if((int32_t)playlistIndex == state.currentPlaylist) 
+    state.loadedPlaylistFilepaths.emplace_back(path);
+
+  TrackId id = TrackLibrary::intern(path);
+  playlist.musicFiles.emplace_back(id);
+  // Already loaded through another playlist, a download may just have replaced the file
+  if(TrackLibrary::isUpToDate(id)) return;
+
+  if(state.playlistFileJobs && state.loadingPlaylist != (int32_t)playlistIndex) {
+    // The running jobs belong to another playlist and may get cancelled, this one file is loaded right here
+    SoundFile file;
+    loadSoundFile(path, file);
+    TrackLibrary::store(id, file);
   } else {
-    state.playlistFileThumbnailData.emplace_back((TextureData){0});
+    if(!state.playlistFileJobs) {
+      state.playlistFileJobs = std::make_shared<JobGroup>();
+      state.loadingPlaylist = playlistIndex;
+    }
+    state.jobSystem.submit([id, path](){
+        loadPlaylistFileAsync(id, path);
+        }, JobPriority::Normal, state.playlistFileJobs);
   }
 }
 
+void removeFileFromPlaylist(const std::string& path, uint32_t playlistIndex) {
+  if(!Playlist::containsFile(path, playlistIndex)) return;
+  Playlist& playlist = state.playlists[playlistIndex];
+  std::vector<TrackId>& files = playlist.musicFiles;
+
+  TrackId removedId = TrackLibrary::find(path);
+  // The track may also play from another playlist, that playback goes on
+  if(state.playingPlaylist == (int32_t)playlistIndex && state.currentTrack != INVALID_TRACK_ID && 
+      state.currentTrack == removedId) {
+    if(state.soundHandler.isInit) {
+      state.soundHandler.stop();
+      state.soundHandler.uninit();
+    }
+    state.currentTrack = INVALID_TRACK_ID;
+  }
+
+  // Erasing moves the rows behind it, the marked row is looked up again afterwards
+  TrackId playingId = INVALID_TRACK_ID;
+  if(playlist.playingFile >= 0 && playlist.playingFile < (int32_t)files.size()) 
+    playingId = files[playlist.playingFile];
+  if(playingId == removedId) playingId = INVALID_TRACK_ID;
+  playlist.playingFile = -1;
+
+  Playlist::removeFile(path, playlistIndex);
+
+  if(playingId != INVALID_TRACK_ID) {
+    auto it = std::find(files.begin(), files.end(), playingId);
+    if(it != files.end()) 
+      playlist.playingFile = std::distance(files.begin(), it);
+  }
+}
+
+void openDownloadedPlaylist() {
+  loadPlaylists();
+  auto it = std::find(state.playlists.begin(), state.playlists.end(), 
+      (Playlist){.path = LYSSA_DIR + "/playlists/" + state.downloadingPlaylistName});
+  state.currentPlaylist = it != state.playlists.end() ? std::distance(state.playlists.begin(), it) : 0;
+  auto& playlist = state.playlists[state.currentPlaylist];
+  if(!playlist.loaded) {
+    state.loadedPlaylistFilepaths.clear();
+    state.loadedPlaylistFilepaths.shrink_to_fit();
+
+    state.loadedPlaylistFilepaths = PlaylistMetadata::getFilepaths(std::filesystem::directory_entry(playlist.path));
+    loadPlaylistAsync(playlist);
+    playlist.loaded = true;
+  }
+  changeTabTo(GuiTab::OnPlaylist);
+}
+
 std::vector<std::string> loadFilesFromFolder(const std::filesystem::path& folderPath) {
   std::vector<std::string> files;
   for (const auto& entry : std::filesystem::directory_iterator(folderPath)) {
@@ -3092,12 +3310,13 @@ std::vector<std::string> loadFilesFromFolder(const std::filesystem::path& folder
 }
 
 void moveFileInPlaylistIdx(uint32_t playlistIndex, uint32_t fromIndex, uint32_t toIndex) {
-  std::vector<SoundFile>& files = state.playlists[playlistIndex].musicFiles;
+  std::vector<TrackId>& files = state.playlists[playlistIndex].musicFiles;
   if (fromIndex < 0 || fromIndex >= files.size() || toIndex < 0 || toIndex >= files.size()) {
     LOG_ERROR("Index out of range. files.size(): %i, fromIndex: %i, toIndex: %i", (int32_t)files.size(), fromIndex, toIndex);
+    return;
   }
 
-  SoundFile element = files[fromIndex];
+  TrackId element = files[fromIndex];
   if (fromIndex < toIndex) {
     files.insert(files.begin() + toIndex + 1, element);
     files.erase(files.begin() + fromIndex);
@@ -3105,85 +3324,176 @@ void moveFileInPlaylistIdx(uint32_t playlistIndex, uint32_t fromIndex, uint32_t
     files.erase(files.begin() + fromIndex);
     files.insert(files.begin() + toIndex, element);
   }
+  PlaylistMetadata::moveFile(state.playlists[playlistIndex].path, fromIndex, toIndex);
 }
 
 void playlistPlayFileWithIndex(uint32_t i, uint32_t playlistIndex) {
-  if(!state.playlistFileFutures.empty()) return;
   Playlist& playlist = state.playlists[playlistIndex];
   playlist.playingFile = i;
   playlist.selectedFile = i;
 
-  if(state.soundHandler.isPlaying)
-    state.soundHandler.stop();
-
-  if(state.soundHandler.isInit)
-    state.soundHandler.uninit();
-
-  state.soundHandler.init(playlist.musicFiles[i].path.string(), miniaudioDataCallback);
+  // The playback device stays open, only the decoder is replaced
+  state.soundHandler.init(TrackLibrary::getPath(playlist.musicFiles[i]).string(), miniaudioDataCallback);
   state.soundHandler.play();
 
   state.currentSoundPos = 0.0;
   state.trackProgressSlider.max = state.soundHandler.lengthInSeconds;
 
+  markSoundAsPlayed(i, playlistIndex);
+  queueNextSound(playlistIndex);
+}
+
+void markSoundAsPlayed(uint32_t i, uint32_t playlistIndex) {
   if(state.playingPlaylist != playlistIndex) {
     state.alreadyPlayedTracks.clear();
+    state.playedTrackCount = 0;
   }
   state.playingPlaylist = playlistIndex;
 
-  if(std::find(state.alreadyPlayedTracks.begin(), state.alreadyPlayedTracks.end(), i) == state.alreadyPlayedTracks.end()) {
-    state.alreadyPlayedTracks.push_back(i);
+  // Indexed by row, rows that were added since are unplayed
+  uint32_t fileCount = state.playlists[playlistIndex].musicFiles.size();
+  if(state.alreadyPlayedTracks.size() < fileCount) state.alreadyPlayedTracks.resize(fileCount, false);
+  if(i < state.alreadyPlayedTracks.size() && !state.alreadyPlayedTracks[i]) {
+    state.alreadyPlayedTracks[i] = true;
+    state.playedTrackCount++;
   }
-  if(state.alreadyPlayedTracks.size() >= state.playlists[state.currentPlaylist].musicFiles.size()) {
+  if(state.playedTrackCount >= fileCount) {
     state.alreadyPlayedTracks.clear();
+    state.playedTrackCount = 0;
   }
 }
 
-void skipSoundUp(uint32_t playlistInedx) {
-  Playlist& playlist = state.playlists[playlistInedx];
+// A random index that was not played yet, any index once every one of them was played.
+// -1 if the playlist is empty.
+int32_t getShuffledSoundIndex(const Playlist& playlist) {
+  if(playlist.musicFiles.empty()) return -1;
+  std::vector<uint32_t> unplayed;
+  for(uint32_t i = 0; i < playlist.musicFiles.size(); i++) {
+    if(i >= state.alreadyPlayedTracks.size() || !state.alreadyPlayedTracks[i])
+      unplayed.emplace_back(i);
+  }
+  if(unplayed.empty()) {
+    RandomEngine random(0, playlist.musicFiles.size() - 1);
+    return random.randInt();
+  }
+  RandomEngine random(0, unplayed.size() - 1);
+  return unplayed[random.randInt()];
+}
+
+int32_t getNextSoundIndex(uint32_t playlistIndex) {
+  Playlist& playlist = state.playlists[playlistIndex];
+  if(playlist.musicFiles.empty()) return -1;
+
+  if(state.replayTrack) return playlist.playingFile;
 
+  int32_t next;
   if(!state.shuffle) {
     if(playlist.playingFile + 1 < playlist.musicFiles.size())
+      next = playlist.playingFile + 1;
+    else 
+      next = 0;
+  } else {
+    next = getShuffledSoundIndex(playlist);
+  }
+  return next;
+}
+
+void queueNextSound(uint32_t playlistIndex) {
+  state.queuedSoundIndex = getNextSoundIndex(playlistIndex);
+  state.queuedShuffle = state.shuffle;
+  state.queuedReplay = state.replayTrack;
+  if(state.queuedSoundIndex == -1) {
+    state.soundHandler.cancelPreload();
+    return;
+  }
+  state.soundHandler.preloadNext(TrackLibrary::getPath(state.playlists[playlistIndex].musicFiles[state.queuedSoundIndex]).string());
+}
+
+void handleTrackSwitch() {
+  if(!state.soundHandler.pollTrackSwitch()) return;
+
+  // The data callback already continued with the preloaded sound, 
+  // only the UI needs to catch up here.
+  Playlist& playlist = state.playlists[state.playingPlaylist];
+  int32_t index = state.queuedSoundIndex;
+  TrackId playingId = TrackLibrary::find(state.soundHandler.path);
+  if(index < 0 || index >= (int32_t)playlist.musicFiles.size() || playlist.musicFiles[index] != playingId) {
+    auto it = std::find(playlist.musicFiles.begin(), playlist.musicFiles.end(), playingId);
+    if(it == playlist.musicFiles.end()) {
+      terminateAudio();
+      return;
+    }
+    index = std::distance(playlist.musicFiles.begin(), it);
+  }
+  playlist.playingFile = index;
+  playlist.selectedFile = index;
+
+  state.currentTrack = playlist.musicFiles[index];
+  if(state.currentTab == GuiTab::OnTrack || state.currentTab == GuiTab::TrackFullscreen) {
+    if(state.onTrackTab.trackThumbnail.width != 0) {
+      lf_free_texture(&state.onTrackTab.trackThumbnail);
+    }
+    state.onTrackTab.trackThumbnail = SoundTagParser::getSoundThubmnail(TrackLibrary::getPath(state.currentTrack));
+  }
+
+  state.currentSoundPos = 0.0;
+  state.trackProgressSlider.max = state.soundHandler.lengthInSeconds;
+
+  markSoundAsPlayed(index, state.playingPlaylist);
+  queueNextSound(state.playingPlaylist);
+
+  playlist.scroll = -playlist.getFileRenderPosY(index);
+}
+
+void skipSoundUp(uint32_t playlistInedx) {
+  Playlist& playlist = state.playlists[playlistInedx];
+  if(playlist.musicFiles.empty()) return;
+
+  // Take the already preloaded sound, so that shuffle picks the same track that was queued
+  int32_t queued = state.queuedSoundIndex;
+  if(playlistInedx == state.playingPlaylist && queued >= 0 && queued < (int32_t)playlist.musicFiles.size() && 
+      queued != playlist.playingFile && state.queuedShuffle == state.shuffle) {
+    playlist.playingFile = queued;
+  } else if(!state.shuffle) {
+    if(playlist.playingFile + 1 < (int32_t)playlist.musicFiles.size())
       playlist.playingFile++;
     else 
       playlist.playingFile = 0;
   } else {
-    RandomEngine random(0, playlist.musicFiles.size() - 1);
-    playlist.playingFile = random.randInt();
-    while(std::find(state.alreadyPlayedTracks.begin(), state.alreadyPlayedTracks.end(), playlist.playingFile) != state.alreadyPlayedTracks.end()) {
-      playlist.playingFile = random.randInt();
-    }
+    playlist.playingFile = getShuffledSoundIndex(playlist);
   }
 
-  state.currentSoundFile = &playlist.musicFiles[playlist.playingFile];
+  state.currentTrack = playlist.musicFiles[playlist.playingFile];
   if(state.currentTab == GuiTab::OnTrack || state.currentTab == GuiTab::TrackFullscreen) {
     if(state.onTrackTab.trackThumbnail.width != 0) {
       lf_free_texture(&state.onTrackTab.trackThumbnail);
     }
-    state.onTrackTab.trackThumbnail = SoundTagParser::getSoundThubmnail(state.currentSoundFile->path);
+    state.onTrackTab.trackThumbnail = SoundTagParser::getSoundThubmnail(TrackLibrary::getPath(state.currentTrack));
   }
 
   playlistPlayFileWithIndex(playlist.playingFile, playlistInedx);
-  float filePosY = playlist.musicFiles[playlist.playingFile].renderPosY;
+  float filePosY = playlist.getFileRenderPosY(playlist.playingFile);
   playlist.scroll = -filePosY;
 }
 
 void skipSoundDown(uint32_t playlistIndex) {
   Playlist& playlist = state.playlists[playlistIndex];
+  if(playlist.musicFiles.empty()) return;
 
-  if(playlist.playingFile - 1 >= 0)
+  if(playlist.playingFile - 1 >= 0 && playlist.playingFile <= (int32_t)playlist.musicFiles.size())
     playlist.playingFile--;
   else 
     playlist.playingFile = playlist.musicFiles.size() - 1; 
 
-  state.currentSoundFile = &playlist.musicFiles[playlist.playingFile];
+  state.currentTrack = playlist.musicFiles[playlist.playingFile];
   if(state.currentTab == GuiTab::OnTrack || state.currentTab == GuiTab::TrackFullscreen) {
     if(state.onTrackTab.trackThumbnail.width != 0)
       lf_free_texture(&state.onTrackTab.trackThumbnail);
-    state.onTrackTab.trackThumbnail = SoundTagParser::getSoundThubmnail(state.currentSoundFile->path);
+    state.onTrackTab.trackThumbnail = SoundTagParser::getSoundThubmnail(TrackLibrary::getPath(state.currentTrack));
   }
 
   playlistPlayFileWithIndex(playlist.playingFile, playlistIndex);
-  float filePosY = playlist.musicFiles[playlist.playingFile].renderPosY;
+  float filePosY = playlist.getFileRenderPosY(playlist.playingFile);
   playlist.scroll = -filePosY;
 }
 void updateSoundProgress() {
@@ -3191,17 +3501,23 @@ void updateSoundProgress() {
     return;
   }
 
-  if(state.currentSoundPos + 1 <= state.soundHandler.lengthInSeconds && state.soundHandler.isPlaying) {
-    state.soundPosUpdateTime += state.deltaTime;
-    if(state.soundPosUpdateTime >= state.soundPosUpdateTimer) {
-      state.soundPosUpdateTime = 0.0f;
-      state.currentSoundPos++;
-    }
+  handleTrackSwitch();
+
+  // Shuffle or replay was toggled after the next sound was chosen
+  if(state.queuedShuffle != state.shuffle || state.queuedReplay != state.replayTrack) {
+    queueNextSound(state.playingPlaylist);
+  }
+
+  // The slider writes into currentSoundPos while it is dragged
+  if(!state.trackProgressSlider.held) {
+    state.currentSoundPos = (int32_t)state.soundHandler.getPositionInSeconds();
   }
 
-  if(state.currentSoundPos >= (uint32_t)state.soundHandler.lengthInSeconds && !state.trackProgressSlider.held) {
+  // If the next sound is preloaded, the data callback switches to it without a gap
+  // and no end of stream is posted.
+  if(state.soundHandler.pollEndOfStream()) {
     if(!state.replayTrack) {
-      skipSoundUp(state.currentPlaylist);
+      skipSoundUp(state.playingPlaylist);
     } else {
       state.currentSoundPos = 0.0f;
       state.soundHandler.setPositionInSeconds(state.currentSoundPos);
@@ -3223,10 +3539,11 @@ void terminateAudio() {
   if(!state.soundHandler.isInit || !ASYNC_PLAYLIST_LOADING) return;
   state.soundHandler.stop();
   state.soundHandler.uninit();
-  state.previousSoundFile = state.currentSoundFile;
+  state.previousTrack = state.currentTrack;
   state.previousSoundPos = state.currentSoundPos;
-  state.currentSoundFile = nullptr;
-  state.playlists[state.currentPlaylist].playingFile = -1;
+  state.currentTrack = INVALID_TRACK_ID;
+  if(state.playingPlaylist != -1)
+    state.playlists[state.playingPlaylist].playingFile = -1;
 }
 
 std::string removeFileExtensionW(const std::string& filename) {
@@ -3248,128 +3565,123 @@ void loadIcons() {
   }
 }
 
-bool playlistFileOrderCorrect(uint32_t playlistIndex, const std::vector<std::string>& paths) {
-  const std::vector<SoundFile>& soundFiles = state.playlists[playlistIndex].musicFiles;
-
-  if (soundFiles.size() != paths.size()) {
-    return false;
-  }
-
-  for (size_t i = 0; i < soundFiles.size(); ++i) {
-    if (soundFiles[i].path != paths[i]) {
-      return false;
-    }
-  }
-
-  return true;
-}
-
-std::vector<SoundFile> reorderPlaylistFiles(const std::vector<SoundFile>& soundFiles, const std::vector<std::string>& paths) {
-  std::vector<SoundFile> reorderedVector;
-  reorderedVector.reserve(soundFiles.size());
-
-  for (const auto& path : paths) {
-    for (const auto& file : soundFiles) {
-      if (file.path == path) {
-        reorderedVector.emplace_back(file);
-        break;
-      }
-    }
-  }
-
-  return reorderedVector;
-}
-
-static bool compareSoundFilesByName(const SoundFile& a, const SoundFile& b) {
-    std::string filenameA = removeFileExtensionW(a.path.filename().string());
-    std::string filenameB = removeFileExtensionW(b.path.filename().string());
-    return filenameA < filenameB;
-}
-static bool compareTextureDataByName(const TextureData& a, const TextureData& b) {
-    return removeFileExtension(a.path.filename()) < removeFileExtension(b.path.filename());
-}
-
 void handleAsyncPlaylistLoading() {
-  for (uint32_t i = 0; i < state.playlistFileThumbnailData.size(); i++) {
-    SoundFile& file = state.playlists[state.currentPlaylist].musicFiles[i];
-    if(file.loaded) continue;
-    file.loaded = true;
-  }
-  if(state.loadedPlaylistFilepaths.size() == state.playlists[state.currentPlaylist].musicFiles.size() && !state.playlistFileFutures.empty()) {
-    // Create OpenGL Textures for the thumbnails that were loaded
-    for (uint32_t i = 0; i < state.playlistFileThumbnailData.size(); i++) {
-      SoundFile& file = state.playlists[state.currentPlaylist].musicFiles[i];
-      LfTexture& thumbnail = file.thumbnail;
-      TextureData data = state.playlistFileThumbnailData[i];
-      lf_create_texture_from_image_data(LF_TEX_FILTER_LINEAR, &thumbnail.id, data.width, data.height, data.channels, data.data);
-      thumbnail.width = data.width;
-      thumbnail.height = data.height;
-    } 
-    if(state.currentPlaylist != -1) {
-      for (auto &future : state.playlistFileFutures) {
-        future.get(); // Wait for each future to complete
-      } 
-      state.playlistFileFutures.clear(); 
-      Playlist& playlist = state.playlists[state.currentPlaylist];
-      std::sort(playlist.musicFiles.begin(), playlist.musicFiles.end(), compareSoundFilesByName);
-      std::sort(state.playlistFileThumbnailData.begin(), state.playlistFileThumbnailData.end(), compareTextureDataByName);
-
-      if(state.previousSoundFile) {
+  if(!state.playlistFileJobs) return;
+  // Every job publishes its file before it counts as done, so checking first
+  // guarantees that the drain below picks up the last files.
+  bool done = state.playlistFileJobs->isDone();
+  state.loadedPlaylistFiles.drain([](LoadedSoundFile&& loaded){
+      // Every row of the track in any playlist shows it from now on
+      TrackLibrary::store(loaded.trackId, loaded.file);
+      });
+  if(done) {
+    if(state.loadingPlaylist != -1) {
+      state.playlistFileJobs = nullptr;
+      state.unboostedFileLoads.clear();
+      state.jobSystem.submit(MetadataCache::save, JobPriority::Low);
+      state.loadingPlaylist = -1;
+
+      if(state.previousTrack != INVALID_TRACK_ID) {
         Playlist& playingPlaylist = state.playlists[state.playingPlaylist];
-        auto it = std::find(playingPlaylist.musicFiles.begin(), playingPlaylist.musicFiles.end(), (SoundFile){.path = state.previousSoundFile->path});
+        auto it = std::find(playingPlaylist.musicFiles.begin(), playingPlaylist.musicFiles.end(), state.previousTrack);
         if(it != playingPlaylist.musicFiles.end()) {
           uint32_t index = std::distance(playingPlaylist.musicFiles.begin(), it);
           playlistPlayFileWithIndex(index, state.playingPlaylist);
-          state.currentSoundFile = state.previousSoundFile;
+          state.currentTrack = state.previousTrack;
           state.currentSoundPos = state.previousSoundPos;
           state.soundHandler.setPositionInSeconds(state.currentSoundPos);
         }
+        // Files that are added later must not resume it again
+        state.previousTrack = INVALID_TRACK_ID;
       }
     }
   }
 }
 
+void cancelPlaylistLoading() {
+  if(!state.playlistFileJobs) return;
+  state.playlistFileJobs->cancel();
+  state.playlistFileJobs->wait();
+  state.playlistFileJobs = nullptr;
+  state.unboostedFileLoads.clear();
+  // The tracks the jobs that already ran published are valid, whichever playlist they belong to
+  state.loadedPlaylistFiles.drain([](LoadedSoundFile&& loaded){
+      TrackLibrary::store(loaded.trackId, loaded.file);
+      });
+
+  // The playlist only got loaded partially, it is read again once it is opened. The one
+  // that plays keeps its rows, playback indexes into them.
+  if(state.loadingPlaylist != -1) {
+    if(state.loadingPlaylist != state.playingPlaylist)
+      Playlist::clearFiles(state.loadingPlaylist);
+    state.playlists[state.loadingPlaylist].loaded = false;
+  }
+  state.loadingPlaylist = -1;
+}
+
 void loadPlaylistAsync(Playlist& playlist) {
-  playlist.musicFiles.clear();
-  state.playlistFileThumbnailData.clear();
-  state.playlistFileThumbnailData.shrink_to_fit();
+  cancelPlaylistLoading();
+  Playlist::clearFiles(state.currentPlaylist);
+
+  if(ASYNC_PLAYLIST_LOADING) {
+    state.playlistFileJobs = std::make_shared<JobGroup>();
+    state.loadingPlaylist = state.currentPlaylist;
+  }
 
+  // The rows that fit on the screen when the playlist opens load first
+  uint32_t visibleRows = state.win->getHeight() / PLAYLIST_FILE_THUMBNAIL_SIZE.y;
 
+  // Playlists in the old text format may list a file twice
+  std::unordered_set<TrackId> addedTracks;
   for(auto& path : state.loadedPlaylistFilepaths) {
-    if(!Playlist::containsFile(path, state.currentPlaylist)){ 
+    TrackId id = TrackLibrary::intern(path);
+    if(!addedTracks.emplace(id).second) continue;
+    uint32_t fileIndex = playlist.musicFiles.size();
+    playlist.musicFiles.emplace_back(id);
+
+    // Tracks that another playlist loaded already are only read again if their file changed
+    if(TrackLibrary::isLoaded(id)) {
       if(ASYNC_PLAYLIST_LOADING) {
-        state.playlistFileFutures.emplace_back(std::async(std::launch::async, loadPlaylistFileAsync, &state.playlists[state.currentPlaylist].musicFiles, path));
-     } else {
+        FileStamp stamp = TrackLibrary::getStamp(id);
+        state.jobSystem.submit([id, path, stamp](){
+            refreshPlaylistFileAsync(id, path, stamp);
+            }, JobPriority::Low, state.playlistFileJobs);
+      } else if(!TrackLibrary::isUpToDate(id)) {
         SoundFile file;
-        if(std::filesystem::exists(std::filesystem::path(path))) {
-          SoundMetadata metadata = SoundTagParser::getSoundMetadataNoThumbnail(path); 
-          file = (SoundFile){
-            .path = path,
-              .artist = metadata.artist, 
-              .title = metadata.title,
-              .releaseYear = metadata.releaseYear,
-              .duration = static_cast<int32_t>(metadata.duration),
-              .thumbnail = SoundTagParser::getSoundThubmnail(path, PLAYLIST_FILE_THUMBNAIL_SIZE),
-          };
-
-        } else {
-          file = (SoundFile){
-            .path = "File cannot be loaded",
-              .duration = 0, 
-              .thumbnail = (LfTexture){0}
-          };
-        }
-        playlist.musicFiles.emplace_back(file);
+        loadSoundFile(path, file);
+        TrackLibrary::store(id, file);
       }
+      continue;
+    }
+    if(ASYNC_PLAYLIST_LOADING && fileIndex < visibleRows) {
+      // Every row shows up right away in its saved position, the job fills it in
+      state.jobSystem.submit([id, path](){
+          loadPlaylistFileAsync(id, path);
+          }, JobPriority::High, state.playlistFileJobs);
+    } else if(ASYNC_PLAYLIST_LOADING) {
+      // Rows below the screen can be boosted once they are scrolled into view
+      auto claim = std::make_shared<std::atomic<bool>>(false);
+      state.unboostedFileLoads[id] = claim;
+      state.jobSystem.submit([id, path, claim](){
+          if(!claim->exchange(true)) loadPlaylistFileAsync(id, path);
+          }, JobPriority::Normal, state.playlistFileJobs);
+    } else {
+      SoundFile file;
+      loadSoundFile(path, file);
+      TrackLibrary::store(id, file);
     }
   }
   if(!ASYNC_PLAYLIST_LOADING) {
-    std::sort(playlist.musicFiles.begin(), playlist.musicFiles.end(), compareSoundFilesByName);
+    state.jobSystem.submit(MetadataCache::save, JobPriority::Low);
   }
 }
 
-LfClickableItemState renderSoundFileThumbnail(vec2s thumbnailContainerSize, SoundFile& file, const std::function<void()>& clickCb, bool uiResponse, float cornerRadius) {
-  LfTexture thumbnail = (file.thumbnail.width == 0) ? state.icons["music_note"] : file.thumbnail;
+LfClickableItemState renderSoundFileThumbnail(vec2s thumbnailContainerSize, TrackId trackId, const std::function<void()>& clickCb, bool uiResponse, float cornerRadius) {
+  // Only artwork inside the viewport is requested, requesting it every frame keeps it on the GPU
+  LfAABB divAABB = lf_get_current_div().aabb;
+  bool visible = lf_get_ptr_y() + thumbnailContainerSize.y >= divAABB.pos.y && lf_get_ptr_y() <= divAABB.pos.y + divAABB.size.y;
+  LfTexture artwork = visible ? ArtworkRegistry::get(TrackLibrary::getArtworkHash(trackId), TrackLibrary::getPath(trackId)) : (LfTexture){0};
+  LfTexture thumbnail = (artwork.width == 0) ? state.icons["music_note"] : artwork;
   float aspect = (float)thumbnail.width / (float)thumbnail.height;
   float thumbnailHeight = thumbnailContainerSize.y / aspect; 
   LfUIElementProps props = lf_get_theme().button_props;
@@ -3383,12 +3695,12 @@ LfClickableItemState renderSoundFileThumbnail(vec2s thumbnailContainerSize, Soun
   props.margin_bottom = 0.0f;
   lf_push_style_props(props);
   LfClickableItemState thumbnailState = lf_item(thumbnailContainerSize);
-  if(thumbnailState == LF_CLICKED && state.playlistFileFutures.empty() && uiResponse) {
-    state.currentSoundFile = &file;
+  if(thumbnailState == LF_CLICKED && uiResponse) {
+    state.currentTrack = trackId;
     if(state.onTrackTab.trackThumbnail.width != 0) {
       lf_free_texture(&state.onTrackTab.trackThumbnail);
     }
-    state.onTrackTab.trackThumbnail = SoundTagParser::getSoundThubmnail(state.currentSoundFile->path, (vec2s){-1, -1});
+    state.onTrackTab.trackThumbnail = SoundTagParser::getSoundThubmnail(TrackLibrary::getPath(trackId), (vec2s){-1, -1});
     changeTabTo(GuiTab::OnTrack);
 
     if(clickCb)
@@ -3450,13 +3762,13 @@ bool renderMenuBarElement(const std::string& text, uint32_t iconId) {
   return onDiv && lf_mouse_button_is_released(GLFW_MOUSE_BUTTON_LEFT);
 }
 
-std::vector<SoundFile> matchSoundFiles(const std::vector<SoundFile>& files, const std::string& searchTerm) {
-  std::vector<SoundFile> matches;
+std::vector<TrackId> matchSoundFiles(const std::vector<TrackId>& files, const std::string& searchTerm) {
+  std::vector<TrackId> matches;
   std::string searchTermLower = LyssaUtils::toLower(std::string(searchTerm.begin(), searchTerm.end())); 
-  for (const auto& soundFile : files) {
-    std::string titleLower = LyssaUtils::toLower(soundFile.title);
+  for (TrackId id : files) {
+    std::string titleLower = LyssaUtils::toLower(TrackLibrary::getTitle(id));
     if (titleLower.find(searchTermLower) != std::string::npos) {
-      matches.push_back(soundFile);
+      matches.push_back(id);
     }
   }
   return matches;
@@ -3477,6 +3789,18 @@ LfTextProps renderTextRaw(vec2s pos, const std::string& text, LfFont font, LfCol
       noRender, false, -1, -1);
 }
 
+std::string formatBytes(double bytes) {
+  const char* units[] = {"B", "KB", "MB", "GB"};
+  uint32_t unit = 0;
+  while(bytes >= 1024.0 && unit < 3) {
+    bytes /= 1024.0;
+    unit++;
+  }
+  std::stringstream format;
+  format << std::fixed << std::setprecision(unit == 0 ? 0 : 1) << bytes << " " << units[unit];
+  return format.str();
+}
+
 std::string formatDurationToMins(int32_t duration) {
   int32_t minutes = duration / 60;
   int32_t seconds = duration % 60;
@@ -3494,6 +3818,10 @@ int main(int argc, char* argv[]) {
   if(!std::filesystem::exists(LYSSA_DIR)) { 
     std::filesystem::create_directory(LYSSA_DIR);
   }
+  MetadataCache::load();
+  state.jobSystem.init();
+  TextureUploader::init();
+  ProcessManager::init();
   loadPlaylists();
 
   // Creating the popups
@@ -3507,21 +3835,15 @@ int main(int argc, char* argv[]) {
     glClearColor(clearColor.r, clearColor.g, clearColor.b, clearColor.a);
     if(ASYNC_PLAYLIST_LOADING)
       handleAsyncPlaylistLoading();
+    handleDecodedCovers();
+    ArtworkRegistry::update();
 
     // Updating the timestamp of the currently playing sound
     updateSoundProgress();
     updateFullscreenTrackTab();
 
-    if(state.playlistThumbnailDownloadIndex != -1) {
-      if(LyssaUtils::getCommandOutput("pgrep yt-dlp") == "") {
-        Playlist& playlist = state.playlists[state.playlistThumbnailDownloadIndex];
-        if(playlist.thumbnail.width != 0) {
-          lf_free_texture(&playlist.thumbnail);
-        }
-        playlist.thumbnail = lf_load_texture_resized(playlist.thumbnailPath.string().c_str(), false, LF_TEX_FILTER_LINEAR, 180, 180);
-        state.playlistThumbnailDownloadIndex = -1;
-      }
-    }
+    // Reports finished downloads
+    ProcessManager::update();
 
     // Delta-Time calculation
     float currentTime = glfwGetTime();
@@ -3608,8 +3930,12 @@ int main(int argc, char* argv[]) {
     glfwPollEvents();
     state.win->swapBuffers();
   }
-  if(state.playlistDownloadRunning) {
-    system("pkill yt-dlp");
-  }
+  DownloadManager::cancel();
+  ProcessManager::shutdown();
+  cancelPlaylistLoading();
+  state.jobSystem.shutdown();
+  state.soundHandler.shutdown();
+  TextureUploader::shutdown();
+  MetadataCache::save();
   return 0;
 } 
@@ -0,0 +1,282 @@
+#include "metadataCache.hpp"
+#include "config.hpp"
+#include "log.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define METADATA_CACHE_MAGIC "LYMC"
+#define METADATA_CACHE_VERSION 3
+
+// File layout: header, records sorted by pathHash, string table
+struct CacheHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t recordCount;
+  uint32_t stringsSize;
+};
+
+struct CacheString {
+  uint32_t offset, length;
+};
+
+struct CacheRecord {
+  uint64_t pathHash;
+  uint64_t size;
+  int64_t mtime;
+  uint64_t artworkHash;
+  double duration;
+  uint32_t releaseYear;
+  CacheString path, title, artist, album;
+};
+
+struct CacheEntry {
+  uint64_t size;
+  int64_t mtime;
+  SoundTags tags;
+};
+
+static const uint8_t* mapped = nullptr;
+static size_t mappedSize = 0;
+static const CacheRecord* records = nullptr;
+static uint32_t recordCount = 0;
+static const char* strings = nullptr;
+static uint32_t stringsSize = 0;
+
+// Records stored since the last save, they take precedence over the mapped ones
+static std::unordered_map<std::string, CacheEntry> pending;
+static std::mutex cacheMutex;
+// Held for a whole save, cacheMutex only while pending is copied and the file is swapped
+static std::mutex saveMutex;
+
+static bool statFile(const std::string& path, uint64_t& size, int64_t& mtime) {
+  struct stat st;
+  if(stat(path.c_str(), &st) != 0) return false;
+  size = st.st_size;
+  mtime = (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+  return true;
+}
+
+static std::string getString(const CacheString& str) {
+  if((uint64_t)str.offset + str.length > stringsSize) return "";
+  return std::string(strings + str.offset, str.length);
+}
+
+static void unmap() {
+  if(mapped) munmap((void*)mapped, mappedSize);
+  mapped = nullptr;
+  mappedSize = 0;
+  records = nullptr;
+  recordCount = 0;
+  strings = nullptr;
+  stringsSize = 0;
+}
+
+static void map(const std::string& filepath) {
+  int fd = open(filepath.c_str(), O_RDONLY);
+  if(fd == -1) return;
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CacheHeader)) {
+    close(fd);
+    return;
+  }
+  void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(data == MAP_FAILED) {
+    LOG_ERROR("Failed to map metadata cache '%s'.\n", filepath.c_str());
+    return;
+  }
+
+  const CacheHeader* header = (const CacheHeader*)data;
+  if(memcmp(header->magic, METADATA_CACHE_MAGIC, 4) != 0 || header->version != METADATA_CACHE_VERSION ||
+      sizeof(CacheHeader) + (uint64_t)header->recordCount * sizeof(CacheRecord) + header->stringsSize != (uint64_t)st.st_size) {
+    LOG_ERROR("Metadata cache '%s' is invalid, it gets rebuilt.\n", filepath.c_str());
+    munmap(data, st.st_size);
+    return;
+  }
+
+  mapped = (const uint8_t*)data;
+  mappedSize = st.st_size;
+  recordCount = header->recordCount;
+  records = (const CacheRecord*)(mapped + sizeof(CacheHeader));
+  stringsSize = header->stringsSize;
+  strings = (const char*)(records + recordCount);
+}
+
+// Expects cacheMutex to be held
+static const CacheRecord* findRecord(const std::string& path) {
+  uint64_t hash = LyssaUtils::hashBytes(path.data(), path.size());
+  const CacheRecord* it = std::lower_bound(records, records + recordCount, hash,
+      [](const CacheRecord& record, uint64_t hash) { return record.pathHash < hash; });
+  for(; it != records + recordCount && it->pathHash == hash; it++) {
+    if(it->path.length == path.size() && getString(it->path) == path)
+      return it;
+  }
+  return nullptr;
+}
+
+static CacheEntry entryFromRecord(const CacheRecord& record) {
+  CacheEntry entry{};
+  entry.size = record.size;
+  entry.mtime = record.mtime;
+  entry.tags.title = getString(record.title);
+  entry.tags.artist = getString(record.artist);
+  entry.tags.album = getString(record.album);
+  entry.tags.releaseYear = record.releaseYear;
+  entry.tags.duration = record.duration;
+  entry.tags.artworkHash = record.artworkHash;
+  return entry;
+}
+
+static CacheString appendString(std::string& table, const std::string& str) {
+  CacheString ret = {.offset = (uint32_t)table.size(), .length = (uint32_t)str.size()};
+  table += str;
+  return ret;
+}
+
+namespace MetadataCache {
+  void load() {
+    std::lock_guard<std::mutex> saveLock(saveMutex);
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    unmap();
+    map(METADATA_CACHE_FILE);
+  }
+
+  void save() {
+    // The mapping is only replaced by a save, so the records can be read without cacheMutex
+    std::lock_guard<std::mutex> saveLock(saveMutex);
+    std::unordered_map<std::string, CacheEntry> saved;
+    {
+      std::lock_guard<std::mutex> lock(cacheMutex);
+      if(pending.empty()) return;
+      saved = pending;
+    }
+
+    std::vector<std::pair<std::string, CacheEntry>> entries;
+    entries.reserve(recordCount + saved.size());
+    for(uint32_t i = 0; i < recordCount; i++) {
+      std::string path = getString(records[i].path);
+      if(saved.find(path) != saved.end()) continue;
+      entries.emplace_back(path, entryFromRecord(records[i]));
+    }
+    for(auto& [path, entry] : saved) {
+      entries.emplace_back(path, entry);
+    }
+
+    std::vector<CacheRecord> newRecords(entries.size());
+    std::string table;
+    for(size_t i = 0; i < entries.size(); i++) {
+      const std::string& path = entries[i].first;
+      const CacheEntry& entry = entries[i].second;
+      // Written as it is, the padding must not carry garbage into the file
+      CacheRecord& record = newRecords[i];
+      memset(&record, 0, sizeof(record));
+      record.pathHash = LyssaUtils::hashBytes(path.data(), path.size());
+      record.size = entry.size;
+      record.mtime = entry.mtime;
+      record.artworkHash = entry.tags.artworkHash;
+      record.duration = entry.tags.duration;
+      record.releaseYear = entry.tags.releaseYear;
+      record.path = appendString(table, path);
+      record.title = appendString(table, entry.tags.title);
+      record.artist = appendString(table, entry.tags.artist);
+      record.album = appendString(table, entry.tags.album);
+    }
+    std::sort(newRecords.begin(), newRecords.end(),
+        [](const CacheRecord& a, const CacheRecord& b) { return a.pathHash < b.pathHash; });
+
+    CacheHeader header = {
+      .magic = {'L', 'Y', 'M', 'C'},
+      .version = METADATA_CACHE_VERSION,
+      .recordCount = (uint32_t)newRecords.size(),
+      .stringsSize = (uint32_t)table.size(),
+    };
+
+    // Write to a temporary file first, so a crash never leaves a half written cache behind
+    std::string filepath = METADATA_CACHE_FILE;
+    std::string tmpFilepath = filepath + ".tmp";
+    {
+      std::ofstream file(tmpFilepath, std::ios::binary | std::ios::trunc);
+      if(!file.is_open()) {
+        LOG_ERROR("Failed to write metadata cache '%s'.\n", tmpFilepath.c_str());
+        return;
+      }
+      file.write((const char*)&header, sizeof(header));
+      file.write((const char*)newRecords.data(), newRecords.size() * sizeof(CacheRecord));
+      file.write(table.data(), table.size());
+      if(!file.good()) {
+        LOG_ERROR("Failed to write metadata cache '%s'.\n", tmpFilepath.c_str());
+        return;
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    unmap();
+    if(std::rename(tmpFilepath.c_str(), filepath.c_str()) != 0) {
+      LOG_ERROR("Failed to replace metadata cache '%s'.\n", filepath.c_str());
+    }
+    map(filepath);
+    // Records that were stored again while writing are kept for the next save
+    for(auto& [path, entry] : saved) {
+      auto it = pending.find(path);
+      if(it != pending.end() && it->second.size == entry.size && it->second.mtime == entry.mtime)
+        pending.erase(it);
+    }
+  }
+
+  bool lookup(const std::string& path, SoundTags& tags) {
+    uint64_t size;
+    int64_t mtime;
+    if(!statFile(path, size, mtime)) return false;
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto it = pending.find(path);
+    if(it != pending.end()) {
+      if(it->second.size != size || it->second.mtime != mtime) return false;
+      tags = it->second.tags;
+      return true;
+    }
+
+    const CacheRecord* record = findRecord(path);
+    if(!record || record->size != size || record->mtime != mtime) return false;
+    tags = entryFromRecord(*record).tags;
+    return true;
+  }
+
+  void store(const std::string& path, const SoundTags& tags) {
+    uint64_t size;
+    int64_t mtime;
+    if(!statFile(path, size, mtime)) return;
+
+    CacheEntry entry = {.size = size, .mtime = mtime, .tags = tags};
+    // The picture is not part of the cache, only its hash
+    entry.tags.picture.clear();
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    pending[path] = entry;
+  }
+
+  SoundTags getTags(const std::string& path, bool withPicture) {
+    SoundTags tags{};
+    if(lookup(path, tags)) {
+      if(withPicture && tags.artworkHash != 0)
+        tags.picture = SoundTagParser::getSoundPicture(path);
+      return tags;
+    }
+    tags = SoundTagParser::parse(path);
+    store(path, tags);
+    return tags;
+  }
+}
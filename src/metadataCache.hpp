@@ -0,0 +1,25 @@
+#pragma once
+
+#include "soundTagParser.hpp"
+
+#include <string>
+
+// Binary store of parsed track metadata (METADATA_CACHE_FILE) that outlives the process.
+// The file is memory-mapped on load() and holds one record per track, keyed by its path
+// and validated against the size and mtime of the file with a single stat().
+namespace MetadataCache {
+  // Maps the cache file. Called once at startup.
+  void load();
+  // Writes the mapped records together with everything stored since the last save.
+  // Does nothing if nothing was stored. The file is written without blocking lookups and
+  // stores, so it is meant to run as a job.
+  void save();
+
+  // Fills 'tags' (without the picture) if there is a record for 'path' that still matches the file.
+  bool lookup(const std::string& path, SoundTags& tags);
+  void store(const std::string& path, const SoundTags& tags);
+
+  // Cached tags of 'path', parsed and stored on a miss. If 'withPicture' is set,
+  // the picture of tracks that have artwork is read even on a hit.
+  SoundTags getTags(const std::string& path, bool withPicture = true);
+}
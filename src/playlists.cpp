@@ -1,5 +1,6 @@
 #include "playlists.hpp"
 #include "global.hpp"
+#include "metadataCache.hpp"
 #include "soundHandler.hpp"
 #include "soundTagParser.hpp"
 
@@ -7,31 +8,548 @@
 #include <fstream>
 #include <iostream>
 #include <algorithm>
+#include <iomanip>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define PLAYLIST_FILE_MAGIC "LYPL"
+#define PLAYLIST_FILE_VERSION 3
+// The binary playlist file, the journal of edits on top of it and the text format it replaced
+#define PLAYLIST_FILE "/.playlist"
+#define PLAYLIST_JOURNAL_FILE "/.journal"
+#define PLAYLIST_TEXT_FILE "/.metadata"
+
+struct PlaylistString {
+  uint32_t offset, length;
+};
+
+// File layout: header, header strings, path table. Every path in the table is a uint32_t
+// length followed by the bytes. The file is only ever replaced as a whole, edits are
+// appended to the journal and folded into a new file by the compaction.
+struct PlaylistFileHeader {
+  char magic[4];
+  uint32_t version;
+  // Start of the path table
+  uint32_t tableStart;
+  uint32_t fileCount;
+  uint64_t tableEnd;
+  PlaylistString name, desc, url, thumbnail;
+  // Sequence number of the last journal record that is part of the file
+  uint64_t journalSeq;
+};
+// Version 1 files end their header before 'journalSeq'
+#define PLAYLIST_FILE_HEADER_SIZE_V1 offsetof(PlaylistFileHeader, journalSeq)
+
+enum class JournalRecordType : uint32_t {
+  Add = 0,
+  Remove,
+  Move,
+  Header
+};
+
+// Journal layout: records of this header followed by 'size' bytes of payload. Add and Remove
+// carry the path, Move two uint32_t indices and Header four length prefixed strings.
+// A record torn by a crash is cut off before the next one is appended.
+struct JournalRecord {
+  uint64_t seq;
+  JournalRecordType type;
+  uint32_t size;
+};
+
+// What is kept in memory about the playlist file and journal of a playlist, guarded by 'journalMutex'
+struct PlaylistJournal {
+  // Sequence number of the next record, 0 until the journal was scanned
+  uint64_t nextSeq = 0;
+  uint64_t size = 0;
+  // Bumped whenever the playlist file is replaced, a compaction that started before is dropped
+  uint64_t generation = 0;
+  bool compacting = false;
+  // Normalized paths of the playlist, built on the first membership check and updated by every edit after
+  std::unordered_set<std::string> pathIndex;
+  bool indexed = false;
+};
+
+// Held while the playlist file or the journal of any playlist is accessed
+static std::mutex journalMutex;
+static std::unordered_map<std::string, PlaylistJournal> journals;
+
+struct MappedPlaylistFile {
+  const uint8_t* data = nullptr;
+  size_t size = 0;
+
+  ~MappedPlaylistFile() {
+    if(data) munmap((void*)data, size);
+  }
+  const PlaylistFileHeader* header() const {
+    return (const PlaylistFileHeader*)data;
+  }
+  uint64_t journalSeq() const {
+    return header()->version >= 2 ? header()->journalSeq : 0;
+  }
+  // Version 3 files only hold normalized paths
+  bool normalized() const {
+    return header()->version >= 3;
+  }
+  std::string getString(const PlaylistString& str) const {
+    if((uint64_t)str.offset + str.length > size) return "";
+    return std::string((const char*)data + str.offset, str.length);
+  }
+  // Calls 'fn' with every path in the table until it returns false
+  template<typename Fn>
+  void forEachPath(const Fn& fn) const {
+    uint64_t offset = header()->tableStart;
+    for(uint32_t i = 0; i < header()->fileCount; i++) {
+      uint32_t length;
+      if(offset + sizeof(length) > header()->tableEnd) break;
+      memcpy(&length, data + offset, sizeof(length));
+      offset += sizeof(length);
+      if(offset + length > header()->tableEnd) break;
+      if(!fn(std::string_view((const char*)data + offset, length))) break;
+      offset += length;
+    }
+  }
+};
+
+// The playlist file with the journal replayed on top
+struct PlaylistContents {
+  PlaylistHeader header;
+  // Every path once, so the indices of Move records are the rows of the playlist
+  std::vector<std::string> paths;
+  std::unordered_set<std::string> pathSet;
+  // Sequence number of the last record that was replayed
+  uint64_t journalSeq = 0;
+  // Bytes of the journal that were read
+  uint64_t journalSize = 0;
+};
+
+static void appendString(std::string& buffer, PlaylistString& str, const std::string& value) {
+  str.offset = buffer.size();
+  str.length = value.size();
+  buffer += value;
+}
+
+static void appendPath(std::string& buffer, const std::string& path) {
+  uint32_t length = path.size();
+  buffer.append((const char*)&length, sizeof(length));
+  buffer += path;
+}
+
+static std::string readString(std::string_view& buffer) {
+  uint32_t length;
+  if(buffer.size() < sizeof(length)) return "";
+  memcpy(&length, buffer.data(), sizeof(length));
+  length = std::min<size_t>(length, buffer.size() - sizeof(length));
+  std::string str(buffer.substr(sizeof(length), length));
+  buffer.remove_prefix(sizeof(length) + length);
+  return str;
+}
 
-static std::string getMetadataValue(const std::filesystem::directory_entry& playlistDir, const std::string& searchKey) {
-  std::ifstream metadata(playlistDir.path().string() + "/.metadata");
+static std::string serialize(const PlaylistHeader& header, const std::vector<std::string>& paths, uint64_t journalSeq) {
+  PlaylistFileHeader fileHeader = {
+    .magic = {'L', 'Y', 'P', 'L'},
+    .version = PLAYLIST_FILE_VERSION,
+  };
+  std::string buffer(sizeof(PlaylistFileHeader), '\0');
+  appendString(buffer, fileHeader.name, header.name);
+  appendString(buffer, fileHeader.desc, header.desc);
+  appendString(buffer, fileHeader.url, header.url);
+  appendString(buffer, fileHeader.thumbnail, header.thumbnailPath);
+  fileHeader.tableStart = buffer.size();
+  for(auto& path : paths) {
+    appendPath(buffer, path);
+  }
+  fileHeader.fileCount = paths.size();
+  fileHeader.tableEnd = buffer.size();
+  fileHeader.journalSeq = journalSeq;
+  memcpy(buffer.data(), &fileHeader, sizeof(fileHeader));
+  return buffer;
+}
 
-  if(!metadata.is_open()) {
-    LOG_ERROR("Failed to open the metadata of playlist on path '%s'\n", playlistDir.path().string().c_str());
-    return "No valid description";
+// Writes the file that is renamed over the real one afterwards, so a crash never leaves a half
+// written file behind. The data is on disk before it returns, the rename can not overtake it.
+static bool writeTmpFile(const std::string& tmpFilepath, const std::string& data) {
+  int fd = open(tmpFilepath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if(fd == -1) {
+    LOG_ERROR("Failed to write playlist file '%s'.\n", tmpFilepath.c_str());
+    return false;
   }
+  size_t written = 0;
+  while(written < data.size()) {
+    ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+    if(n <= 0) break;
+    written += n;
+  }
+  bool ok = written == data.size() && fsync(fd) == 0;
+  close(fd);
+  if(!ok) {
+    LOG_ERROR("Failed to write playlist file '%s'.\n", tmpFilepath.c_str());
+    std::remove(tmpFilepath.c_str());
+  }
+  return ok;
+}
+
+// Makes a rename inside the playlist directory durable
+static void syncDirectory(const std::filesystem::path& playlistDir) {
+  int fd = open(playlistDir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if(fd == -1) return;
+  fsync(fd);
+  close(fd);
+}
+
+// Reads a playlist in the old text format, every path quoted on the "files:" line
+static bool readTextPlaylist(const std::filesystem::path& playlistDir, PlaylistHeader& header, std::vector<std::string>& paths) {
+  std::ifstream metadata(playlistDir.string() + PLAYLIST_TEXT_FILE);
+  if(!metadata.is_open()) return false;
 
-  std::string ret;
   std::string line;
   while(std::getline(metadata, line)) {
     std::istringstream iss(line);
     std::string key;
     iss >> key;
 
-    if(key == searchKey) {
-      std::getline(iss, ret);
-      ret.erase(0, ret.find_first_not_of(" \t"));
-      ret.erase(ret.find_last_not_of(" \t") + 1);
+    if(key == "files:") {
+      std::string path;
+      while (iss >> std::quoted(path)) {
+        paths.emplace_back(path);
+      }
+      continue;
     }
+    std::string value;
+    std::getline(iss, value);
+    value.erase(0, value.find_first_not_of(" \t"));
+    value.erase(value.find_last_not_of(" \t") + 1);
+    if(key == "name:") header.name = value;
+    else if(key == "desc:") header.desc = value;
+    else if(key == "url:") header.url = value;
+    else if(key == "thumbnail:") header.thumbnailPath = value;
+  }
+  header.fileCount = paths.size();
+  return true;
+}
+
+// Converts a text playlist into the binary format, the text file is kept as .metadata.old
+static bool migrate(const std::filesystem::path& playlistDir) {
+  if(std::filesystem::exists(playlistDir.string() + PLAYLIST_FILE)) return true;
+  PlaylistHeader header;
+  std::vector<std::string> paths;
+  if(!readTextPlaylist(playlistDir, header, paths)) return false;
+  if(!PlaylistMetadata::write(playlistDir, header, paths)) return false;
+  std::error_code ec;
+  std::filesystem::rename(playlistDir.string() + PLAYLIST_TEXT_FILE, playlistDir.string() + PLAYLIST_TEXT_FILE ".old", ec);
+  LOG_INFO("Migrated playlist '%s' to the binary format.\n", playlistDir.string().c_str());
+  return true;
+}
+
+static bool mapFile(const std::filesystem::path& playlistDir, MappedPlaylistFile& file) {
+  std::string filepath = playlistDir.string() + PLAYLIST_FILE;
+  int fd = open(filepath.c_str(), O_RDONLY);
+  if(fd == -1) return false;
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || (size_t)st.st_size < PLAYLIST_FILE_HEADER_SIZE_V1) {
+    close(fd);
+    return false;
+  }
+  void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(data == MAP_FAILED) return false;
+
+  file.data = (const uint8_t*)data;
+  file.size = st.st_size;
+  const PlaylistFileHeader* header = file.header();
+  if(memcmp(header->magic, PLAYLIST_FILE_MAGIC, 4) != 0 || header->version == 0 || header->version > PLAYLIST_FILE_VERSION ||
+      (header->version >= 2 && file.size < sizeof(PlaylistFileHeader)) ||
+      header->tableStart > header->tableEnd || header->tableEnd > file.size) {
+    LOG_ERROR("The playlist file '%s' is invalid.\n", filepath.c_str());
+    return false;
   }
-  return ret;
+  return true;
+}
 
+static std::string getJournalPath(const std::filesystem::path& playlistDir) {
+  return playlistDir.string() + PLAYLIST_JOURNAL_FILE;
+}
+
+static std::string readJournal(const std::filesystem::path& playlistDir) {
+  std::ifstream file(getJournalPath(playlistDir), std::ios::binary);
+  if(!file.is_open()) return "";
+  return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// Calls 'fn' with every complete record, returns the offset after the last one
+template<typename Fn>
+static uint64_t forEachRecord(std::string_view journal, const Fn& fn) {
+  uint64_t offset = 0;
+  while(offset + sizeof(JournalRecord) <= journal.size()) {
+    JournalRecord record;
+    memcpy(&record, journal.data() + offset, sizeof(record));
+    if(record.type > JournalRecordType::Header || offset + sizeof(record) + record.size > journal.size()) break;
+    fn(record, journal.substr(offset + sizeof(record), record.size));
+    offset += sizeof(record) + record.size;
+  }
+  return offset;
 }
+
+// Paths are normalized when they are written, so the index, the file and the journal compare the same strings
+static std::string normalizePath(const std::string& path) {
+  return std::filesystem::path(path).lexically_normal().string();
+}
+
+static void addPath(PlaylistContents& contents, std::string_view path, bool normalize) {
+  std::string str = normalize ? normalizePath(std::string(path)) : std::string(path);
+  if(contents.pathSet.emplace(str).second) 
+    contents.paths.emplace_back(std::move(str));
+}
+
+// Replays a record, without 'withPaths' only the header is of interest. Moves behave like
+// moving a row with drag and drop.
+static void applyRecord(const JournalRecord& record, std::string_view payload, PlaylistContents& contents, bool withPaths) {
+  PlaylistHeader& header = contents.header;
+  std::vector<std::string>* paths = withPaths ? &contents.paths : nullptr;
+  switch(record.type) {
+    case JournalRecordType::Add:
+      if(!paths) {
+        header.fileCount++;
+        break;
+      }
+      // Journals written before paths were normalized
+      addPath(contents, payload, true);
+      header.fileCount = paths->size();
+      break;
+    case JournalRecordType::Remove: {
+      if(!paths) {
+        // Removes are only recorded for paths that are in the playlist
+        if(header.fileCount > 0) header.fileCount--;
+        break;
+      }
+      auto it = std::find(paths->begin(), paths->end(), normalizePath(std::string(payload)));
+      if(it != paths->end()) {
+        contents.pathSet.erase(*it);
+        paths->erase(it);
+        header.fileCount--;
+      }
+      break;
+    }
+    case JournalRecordType::Move: {
+      uint32_t indices[2];
+      if(!paths || payload.size() != sizeof(indices)) break;
+      memcpy(indices, payload.data(), sizeof(indices));
+      uint32_t from = indices[0], to = indices[1];
+      if(from >= paths->size() || to >= paths->size()) break;
+      std::string path = (*paths)[from];
+      if(from < to) {
+        paths->insert(paths->begin() + to + 1, path);
+        paths->erase(paths->begin() + from);
+      } else {
+        paths->erase(paths->begin() + from);
+        paths->insert(paths->begin() + to, path);
+      }
+      break;
+    }
+    case JournalRecordType::Header:
+      header.name = readString(payload);
+      header.desc = readString(payload);
+      header.url = readString(payload);
+      header.thumbnailPath = readString(payload);
+      break;
+  }
+}
+
+// 'journalMutex' must be held, the compaction replaces both files and they have to be read as a pair
+static bool readPlaylistLocked(const std::filesystem::path& playlistDir, PlaylistContents& contents, bool withPaths) {
+  MappedPlaylistFile file;
+  if(!mapFile(playlistDir, file)) return false;
+  std::string journal = readJournal(playlistDir);
+
+  contents.header = (PlaylistHeader){
+    .name = file.getString(file.header()->name),
+    .desc = file.getString(file.header()->desc),
+    .url = file.getString(file.header()->url),
+    .thumbnailPath = file.getString(file.header()->thumbnail),
+    .fileCount = file.header()->fileCount,
+  };
+  if(withPaths) {
+    // Without paths only the pages of the header are touched
+    contents.paths.reserve(file.header()->fileCount);
+    file.forEachPath([&](std::string_view path){
+        addPath(contents, path, !file.normalized());
+        return true;
+        });
+    contents.header.fileCount = contents.paths.size();
+  }
+  contents.journalSeq = file.journalSeq();
+  contents.journalSize = forEachRecord(journal, [&](const JournalRecord& record, std::string_view payload){
+      // Already part of the playlist file
+      if(record.seq <= contents.journalSeq) return;
+      applyRecord(record, payload, contents, withPaths);
+      contents.journalSeq = record.seq;
+      });
+  return true;
+}
+
+static bool readPlaylist(const std::filesystem::path& playlistDir, PlaylistContents& contents, bool withPaths) {
+  if(!migrate(playlistDir)) {
+    LOG_ERROR("Failed to open the metadata of playlist on path '%s'\n", playlistDir.string().c_str());
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(journalMutex);
+  return readPlaylistLocked(playlistDir, contents, withPaths);
+}
+
+// Normalized paths, every one once. Text playlists may list a path twice, only the first one is kept.
+static std::vector<std::string> uniquePaths(const std::vector<std::string>& paths) {
+  std::vector<std::string> unique;
+  unique.reserve(paths.size());
+  std::unordered_set<std::string> seen;
+  for(auto& path : paths) {
+    std::string normal = normalizePath(path);
+    if(seen.emplace(normal).second) unique.emplace_back(std::move(normal));
+  }
+  return unique;
+}
+
+static void indexPaths(PlaylistJournal& journal, const std::vector<std::string>& paths) {
+  journal.pathIndex.clear();
+  journal.pathIndex.reserve(paths.size());
+  for(auto& path : paths) {
+    journal.pathIndex.emplace(path);
+  }
+  journal.indexed = true;
+}
+
+// The journal of a playlist, scanned on first use. 'journalMutex' must be held.
+static PlaylistJournal& getJournal(const std::filesystem::path& playlistDir) {
+  PlaylistJournal& journal = journals[normalizePath(playlistDir.string())];
+  if(journal.nextSeq != 0) return journal;
+
+  MappedPlaylistFile file;
+  uint64_t seq = mapFile(playlistDir, file) ? file.journalSeq() : 0;
+  std::string data = readJournal(playlistDir);
+  journal.size = forEachRecord(data, [&](const JournalRecord& record, std::string_view){
+      seq = std::max(seq, record.seq);
+      });
+  // Records appended behind a torn one would never be read
+  if(journal.size < data.size() && truncate(getJournalPath(playlistDir).c_str(), journal.size) != 0) {
+    LOG_ERROR("Failed to truncate playlist journal '%s'.\n", getJournalPath(playlistDir).c_str());
+  }
+  journal.nextSeq = seq + 1;
+  return journal;
+}
+
+// Folds the journal into a new playlist file, runs on the job system
+static void compact(const std::filesystem::path& playlistDir) {
+  uint64_t generation;
+  {
+    std::lock_guard<std::mutex> lock(journalMutex);
+    generation = journals[normalizePath(playlistDir.string())].generation;
+  }
+  PlaylistContents contents;
+  std::string filepath = playlistDir.string() + PLAYLIST_FILE;
+  std::string tmpFilepath = filepath + ".compact";
+  bool ok = readPlaylist(playlistDir, contents, true) &&
+    writeTmpFile(tmpFilepath, serialize(contents.header, contents.paths, contents.journalSeq));
+
+  std::lock_guard<std::mutex> lock(journalMutex);
+  PlaylistJournal& journal = journals[normalizePath(playlistDir.string())];
+  journal.compacting = false;
+  // The playlist was written as a whole in the meantime
+  if(!ok || journal.generation != generation) {
+    std::remove(tmpFilepath.c_str());
+    return;
+  }
+  if(std::rename(tmpFilepath.c_str(), filepath.c_str()) != 0) {
+    LOG_ERROR("Failed to replace playlist file '%s'.\n", filepath.c_str());
+    std::remove(tmpFilepath.c_str());
+    return;
+  }
+  syncDirectory(playlistDir);
+  journal.generation++;
+
+  // Records appended while the file was written are kept. Should replacing the journal
+  // fail, the folded records stay in it and are skipped through 'journalSeq'.
+  std::string journalPath = getJournalPath(playlistDir);
+  std::string data = readJournal(playlistDir);
+  std::string rest = contents.journalSize < data.size() ? data.substr(contents.journalSize) : "";
+  if(rest.empty()) {
+    std::remove(journalPath.c_str());
+  } else if(!writeTmpFile(journalPath + ".tmp", rest) || std::rename((journalPath + ".tmp").c_str(), journalPath.c_str()) != 0) {
+    LOG_ERROR("Failed to replace playlist journal '%s'.\n", journalPath.c_str());
+    return;
+  }
+  syncDirectory(playlistDir);
+  journal.size = rest.size();
+}
+
+static bool appendRecords(const std::filesystem::path& playlistDir, JournalRecordType type, const std::vector<std::string>& payloads) {
+  if(payloads.empty()) return true;
+  // The records refer to the paths of the binary file
+  if(!migrate(playlistDir)) return false;
+
+  bool startCompaction = false;
+  {
+    std::lock_guard<std::mutex> lock(journalMutex);
+    PlaylistJournal& journal = getJournal(playlistDir);
+    uint64_t seq = journal.nextSeq;
+    std::string buffer;
+    for(auto& payload : payloads) {
+      JournalRecord record = {
+        .seq = seq++,
+        .type = type,
+        .size = (uint32_t)payload.size(),
+      };
+      buffer.append((const char*)&record, sizeof(record));
+      buffer += payload;
+    }
+
+    std::string journalPath = getJournalPath(playlistDir);
+    int fd = open(journalPath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    // An edit counts as saved once it is on disk
+    bool ok = fd != -1 && ::write(fd, buffer.data(), buffer.size()) == (ssize_t)buffer.size() && fdatasync(fd) == 0;
+    if(fd != -1) close(fd);
+    if(!ok) {
+      LOG_ERROR("Failed to append to playlist journal '%s'.\n", journalPath.c_str());
+      // Scanned again before the next append, that cuts off what was written partially
+      journal.nextSeq = 0;
+      return false;
+    }
+    journal.nextSeq = seq;
+    journal.size += buffer.size();
+    if(journal.indexed && (type == JournalRecordType::Add || type == JournalRecordType::Remove)) {
+      for(auto& payload : payloads) {
+        if(type == JournalRecordType::Add) journal.pathIndex.emplace(payload);
+        else journal.pathIndex.erase(payload);
+      }
+    }
+    startCompaction = journal.size > PLAYLIST_JOURNAL_COMPACT_BYTES && !journal.compacting;
+    if(startCompaction) journal.compacting = true;
+  }
+  if(startCompaction) {
+    std::filesystem::path dir = playlistDir;
+    state.jobSystem.submit([dir](){ compact(dir); }, JobPriority::Low);
+  }
+  return true;
+}
+
+static PlaylistHeader getHeader(const Playlist& playlist) {
+  return (PlaylistHeader){
+    .name = playlist.name,
+    .desc = playlist.desc,
+    .url = playlist.url,
+    .thumbnailPath = playlist.thumbnailPath.string(),
+  };
+}
+
 FileStatus Playlist::create(const std::string& name, const std::string& desc, const std::string& url,
     const std::filesystem::path& thumbnailPath) {
   std::string nameCpy = name;
@@ -48,24 +566,21 @@ FileStatus Playlist::create(const std::string& name, const std::string& desc, co
     return FileStatus::AlreadyExists;
   }
 
-  std::ofstream metadata(folderPath + "/.metadata");
-  if(metadata.is_open()) {
-    metadata << "name: " << name << "\n";
-    metadata << "desc: " << desc << "\n";
-    metadata << "url: " << url << "\n";
-    metadata << "thumbnail: " << ((url.empty()) ? thumbnailPath.string() : std::string(folderPath + "/thumbnail.jpg.jpg")) << "\n";
-    metadata << "files: ";
-  } else {
+  PlaylistHeader header = {
+    .name = name,
+    .desc = desc,
+    .url = url,
+    .thumbnailPath = url.empty() ? thumbnailPath.string() : std::string(folderPath + "/thumbnail.jpg.jpg"),
+  };
+  if(!PlaylistMetadata::write(folderPath, header, {}))
     return FileStatus::Failed;
-  }
-  metadata.close();
 
   return FileStatus::Success;
 }
 FileStatus Playlist::rename(const std::string& name, uint32_t playlistIndex) {
   Playlist& playlist = state.playlists[playlistIndex];
   playlist.name = name; 
-  return Playlist::save(playlistIndex);
+  return PlaylistMetadata::setHeader(playlist.path, getHeader(playlist)) ? FileStatus::Success : FileStatus::Failed;
 }
 FileStatus Playlist::remove(uint32_t playlistIndex) {
   Playlist& playlist = state.playlists[playlistIndex];
@@ -81,56 +596,55 @@ FileStatus Playlist::remove(uint32_t playlistIndex) {
 FileStatus Playlist::changeDesc(const std::string& desc, uint32_t playlistIndex) {
   Playlist& playlist = state.playlists[playlistIndex];
   playlist.desc = desc; 
-  return Playlist::save(playlistIndex);
+  return PlaylistMetadata::setHeader(playlist.path, getHeader(playlist)) ? FileStatus::Success : FileStatus::Failed;
 }
-FileStatus changeThumbnail(const std::filesystem::path& thumbnailPath, uint32_t playlistIndex) {
+FileStatus Playlist::changeThumbnail(const std::filesystem::path& thumbnailPath, uint32_t playlistIndex) {
   Playlist& playlist = state.playlists[playlistIndex];
   playlist.thumbnailPath = thumbnailPath; 
-  return Playlist::save(playlistIndex);
+  return PlaylistMetadata::setHeader(playlist.path, getHeader(playlist)) ? FileStatus::Success : FileStatus::Failed;
 }
 
 FileStatus Playlist::save(uint32_t playlistIndex) {
   Playlist& playlist = state.playlists[playlistIndex];
-  std::ofstream metdata(playlist.path.string() + "/.metadata", std::ios::trunc);
-
-  if(!metdata.is_open()) return FileStatus::Failed;
-
-  metdata << "name: " << playlist.name << "\n";
-  metdata << "desc: " << playlist.desc << "\n";
-  metdata << "url: " << playlist.url << "\n";
-  metdata << "thumbnail: " << playlist.thumbnailPath.string() << "\n";
-  metdata << "files: ";
 
-  for(auto& file : playlist.musicFiles) {
-    metdata << "\"" << file.path.string() << "\" ";
+  // A playlist whose files are not loaded keeps the ones that are stored
+  std::vector<std::string> paths;
+  if(playlist.loaded || !playlist.musicFiles.empty()) {
+    paths.reserve(playlist.musicFiles.size());
+    for(TrackId id : playlist.musicFiles) {
+      paths.emplace_back(TrackLibrary::getPath(id).string());
+    }
+  } else {
+    paths = PlaylistMetadata::getFilepaths(std::filesystem::directory_entry(playlist.path));
   }
-  return FileStatus::Success;
-
+  return PlaylistMetadata::write(playlist.path, getHeader(playlist), paths) ? FileStatus::Success : FileStatus::Failed;
 }
 FileStatus Playlist::addFile(const std::filesystem::path& path, uint32_t playlistIndex) {
   if(Playlist::containsFile(path, playlistIndex)) return FileStatus::AlreadyExists;
 
   Playlist& playlist = state.playlists[playlistIndex];
 
-  std::ofstream metadata(playlist.path.string() + "/.metadata", std::ios::app);
-
-  if(!metadata.is_open()) return FileStatus::Failed;
-
   std::ifstream playlistFile(path);
   if(!playlistFile.good()) return FileStatus::Failed;
 
-  metadata.seekp(0, std::ios::end);
-
-  metadata << "\"" << path.string() << "\" ";
-  metadata.close();
+  if(!PlaylistMetadata::appendFile(playlist.path, path.string())) return FileStatus::Failed;
 
   state.loadedPlaylistFilepaths.emplace_back(path);
 
-  playlist.musicFiles.emplace_back((SoundFile){
-      .path = path,  
-      .duration = static_cast<int32_t>(SoundHandler::getSoundDuration(path)),
-      .thumbnail = SoundTagParser::getSoundThubmnail(path, (vec2s){0.1, 0.1})
-      });
+  TrackId id = TrackLibrary::intern(path);
+  if(!TrackLibrary::isUpToDate(id)) {
+    SoundTags tags = MetadataCache::getTags(path.string(), false);
+    TrackLibrary::store(id, (SoundFile){
+      .path = path,
+      .artist = tags.artist,
+      .title = tags.title,
+      .releaseYear = tags.releaseYear,
+      .duration = static_cast<int32_t>(tags.duration),
+      .artworkHash = tags.artworkHash,
+      .stamp = TrackLibrary::readStamp(path)
+    });
+  }
+  playlist.musicFiles.emplace_back(id);
 
   return FileStatus::Success;
 }
@@ -139,84 +653,108 @@ FileStatus Playlist::removeFile(const std::filesystem::path& path, uint32_t play
   Playlist& playlist = state.playlists[playlistIndex];
   if(!Playlist::containsFile(path, playlistIndex)) return FileStatus::Failed;
 
-  for(auto& file : playlist.musicFiles) {
-    if(file.path == path) {
-      playlist.musicFiles.erase(std::find(playlist.musicFiles.begin(), playlist.musicFiles.end(), file));
-      state.loadedPlaylistFilepaths.erase(std::find(state.loadedPlaylistFilepaths.begin(), state.loadedPlaylistFilepaths.end(), path));
-      break;
-    }
+  auto fileIt = std::find(playlist.musicFiles.begin(), playlist.musicFiles.end(), TrackLibrary::find(path));
+  if(fileIt != playlist.musicFiles.end()) {
+    playlist.musicFiles.erase(fileIt);
+    // Only holds the paths of the current playlist
+    auto it = std::find(state.loadedPlaylistFilepaths.begin(), state.loadedPlaylistFilepaths.end(), path);
+    if(it != state.loadedPlaylistFilepaths.end())
+      state.loadedPlaylistFilepaths.erase(it);
   }
-  return Playlist::save(playlistIndex);
+  return PlaylistMetadata::removeFile(playlist.path, path.string()) ? FileStatus::Success : FileStatus::Failed;
+}
+
+void Playlist::clearFiles(uint32_t playlistIndex) {
+  state.playlists[playlistIndex].musicFiles.clear();
 }
 
 bool Playlist::containsFile(const std::filesystem::path& path, uint32_t playlistIndex) {
-  Playlist& playlist = state.playlists[playlistIndex];
-  for(auto& file : playlist.musicFiles) {
-    if(file.path == path) return true;
-  }
-  return false;
+  return PlaylistMetadata::containsFile(state.playlists[playlistIndex].path, path.string());
 }
 bool Playlist::metadataContainsFile(const std::string& path, uint32_t playlistIndex) {
-  std::ifstream file(state.playlists[playlistIndex].path.string() + "/.metadata");
-  std::string line;
-
-  if (file.is_open()) {
-    while (std::getline(file, line)) {
-      if (line.find(path) != std::string::npos) {
-        file.close();
-        return true;
-      }
-    }
-    file.close();
-  } else {
-    LOG_ERROR("[Error] Failed to open the metadata of playlist on path '%s'\n", state.playlists[playlistIndex].path.c_str());
-  }
-
-  return false;
+  return PlaylistMetadata::containsFile(state.playlists[playlistIndex].path, path);
 }
 
-std::string PlaylistMetadata::getName(const std::filesystem::directory_entry& playlistDir) {
-  return getMetadataValue(playlistDir, "name:");
+namespace PlaylistMetadata {
+  bool readHeader(const std::filesystem::path& playlistDir, PlaylistHeader& header) {
+    PlaylistContents contents;
+    if(!readPlaylist(playlistDir, contents, false)) return false;
+    header = contents.header;
+    return true;
+  }
 
-}
+  std::vector<std::string> getFilepaths(const std::filesystem::directory_entry& playlistDir) {
+    PlaylistContents contents;
+    if(!readPlaylist(playlistDir.path(), contents, true)) return {};
+    return contents.paths;
+  }
 
-std::string PlaylistMetadata::getDesc(const std::filesystem::directory_entry& playlistDir) {
-  return getMetadataValue(playlistDir, "desc:");
-}
+  bool containsFile(const std::filesystem::path& playlistDir, const std::string& path) {
+    std::string dirKey = normalizePath(playlistDir.string());
+    {
+      std::lock_guard<std::mutex> lock(journalMutex);
+      auto it = journals.find(dirKey);
+      if(it != journals.end() && it->second.indexed) 
+        return it->second.pathIndex.count(normalizePath(path)) != 0;
+    }
 
-std::string PlaylistMetadata::getUrl(const std::filesystem::directory_entry& playlistDir) {
-  return getMetadataValue(playlistDir, "url:");
-}
+    // The only time the playlist file is read for this playlist
+    PlaylistContents contents;
+    bool ok = migrate(playlistDir);
+    std::lock_guard<std::mutex> lock(journalMutex);
+    PlaylistJournal& journal = journals[dirKey];
+    if(!journal.indexed) {
+      // A playlist without a file stays empty until it is written
+      if(!ok || !readPlaylistLocked(playlistDir, contents, true)) contents.paths.clear();
+      indexPaths(journal, contents.paths);
+    }
+    return journal.pathIndex.count(normalizePath(path)) != 0;
+  }
 
-std::string PlaylistMetadata::getThumbnailPath(const std::filesystem::directory_entry& playlistDir) {
-  return getMetadataValue(playlistDir, "thumbnail:");
-}
+  bool write(const std::filesystem::path& playlistDir, const PlaylistHeader& header, const std::vector<std::string>& filepaths) {
+    std::vector<std::string> paths = uniquePaths(filepaths);
+    std::string filepath = playlistDir.string() + PLAYLIST_FILE;
+    std::string tmpFilepath = filepath + ".tmp";
+
+    std::lock_guard<std::mutex> lock(journalMutex);
+    PlaylistJournal& journal = getJournal(playlistDir);
+    // The paths already contain every edit of the journal
+    if(!writeTmpFile(tmpFilepath, serialize(header, paths, journal.nextSeq - 1))) return false;
+    if(std::rename(tmpFilepath.c_str(), filepath.c_str()) != 0) {
+      LOG_ERROR("Failed to replace playlist file '%s'.\n", filepath.c_str());
+      return false;
+    }
+    syncDirectory(playlistDir);
+    journal.generation++;
+    journal.size = 0;
+    std::remove(getJournalPath(playlistDir).c_str());
+    indexPaths(journal, paths);
+    return true;
+  }
 
-std::vector<std::string> PlaylistMetadata::getFilepaths(const std::filesystem::directory_entry& playlistDir) {
-  std::ifstream metadata(playlistDir.path().string() + "/.metadata");
-  std::vector<std::string> filepaths{};
+  bool appendFiles(const std::filesystem::path& playlistDir, const std::vector<std::string>& paths) {
+    return appendRecords(playlistDir, JournalRecordType::Add, uniquePaths(paths));
+  }
 
-  if(!metadata.is_open()) {
-    LOG_ERROR("Failed to open the metadata of playlist on path '%s'\n", playlistDir.path().string().c_str());
-    return filepaths;
+  bool appendFile(const std::filesystem::path& playlistDir, const std::string& path) {
+    return appendFiles(playlistDir, {path});
   }
 
-  std::string line;
-  while(std::getline(metadata, line)) {
-    std::istringstream iss(line);
-    std::string key;
-    iss >> key;
+  bool removeFile(const std::filesystem::path& playlistDir, const std::string& path) {
+    return appendRecords(playlistDir, JournalRecordType::Remove, {normalizePath(path)});
+  }
 
-    if (line.find("files:") != std::string::npos) {
-      // If the line contains "files:", extract paths from the rest of the line
-      std::istringstream iss(line.substr(line.find("files:") + std::string("files:").length()));
-      std::string path;
+  bool moveFile(const std::filesystem::path& playlistDir, uint32_t fromIndex, uint32_t toIndex) {
+    uint32_t indices[2] = {fromIndex, toIndex};
+    return appendRecords(playlistDir, JournalRecordType::Move, {std::string((const char*)indices, sizeof(indices))});
+  }
 
-      while (iss >> std::quoted(path)) {
-        filepaths.emplace_back(path);
-      }
-    }
+  bool setHeader(const std::filesystem::path& playlistDir, const PlaylistHeader& header) {
+    std::string payload;
+    appendPath(payload, header.name);
+    appendPath(payload, header.desc);
+    appendPath(payload, header.url);
+    appendPath(payload, header.thumbnailPath);
+    return appendRecords(playlistDir, JournalRecordType::Header, {payload});
   }
-  return filepaths;
 }
-
@@ -1,6 +1,7 @@
 #pragma once 
 
 #include "config.hpp"
+#include "trackLibrary.hpp"
 #include <filesystem>
 
 extern "C" {
@@ -16,22 +17,9 @@ enum class FileStatus {
   Failed,
   AlreadyExists, 
 };
-struct SoundFile {
-  std::filesystem::path path;
-  std::string artist, title;
-  uint32_t releaseYear;
-  int32_t duration;
-  LfTexture thumbnail;
-  bool loaded;
-
-  float renderPosY;
-
-  bool operator==(const SoundFile& other) const {
-    return path == other.path;
-  }
-};
 struct Playlist {
-  std::vector<SoundFile> musicFiles;
+  // Ids of the tracks in the TrackLibrary, in playlist order
+  std::vector<TrackId> musicFiles;
 
   std::string name, desc, url;
   // Moving the file that is being dragged  
@@ -45,6 +33,13 @@ struct Playlist {
     return path == other.path;
   }
   float scroll = 0.0f, scrollVelocity = 0.0f;
+  // Layout of the file list of the last frame, rows all have the same height
+  float filesStartY = 0.0f, fileRowHeight = 0.0f;
+
+  // Y position of a row in the file list relative to the scroll, also for rows that are not rendered
+  float getFileRenderPosY(uint32_t index) const { 
+    return filesStartY + index * fileRowHeight;
+  }
 
   static FileStatus create(const std::string& name, const std::string& desc, const std::string& url = "",
       const std::filesystem::path& thumbnailPath = "");
@@ -55,18 +50,46 @@ struct Playlist {
   static FileStatus changeThumbnail(const std::filesystem::path& thumbnailPath, uint32_t playlistIndex);
   static FileStatus addFile(const std::filesystem::path& path, uint32_t playlistIndex);
   static FileStatus removeFile(const std::filesystem::path& path, uint32_t playlistIndex);
+  // Clears the loaded files, their thumbnails are evicted by the ArtworkRegistry once unused
+  static void clearFiles(uint32_t playlistIndex);
 
+  // Both look the path up in the in-memory path index of the playlist, also if its files are not loaded
   static bool containsFile(const std::filesystem::path& path, uint32_t playlistIndex);
   static bool metadataContainsFile(const std::string& path, uint32_t playlistIndex);
 
 };
 
+// What the playlist file stores besides the paths
+struct PlaylistHeader {
+  std::string name, desc, url, thumbnailPath;
+  uint32_t fileCount = 0;
+};
+
+// The playlist file (.playlist) of a playlist directory. It is binary with a small header and
+// a table of length prefixed paths, it gets memory-mapped for reading. Edits are appended as
+// small records to a journal (.journal) that is replayed on top when reading. Once the journal
+// exceeds PLAYLIST_JOURNAL_COMPACT_BYTES it is folded into a new playlist file on the job system.
+// Playlists in the old text format (.metadata) are migrated the first time they are accessed.
 namespace PlaylistMetadata {
-  std::string getName(const std::filesystem::directory_entry& playlistDir); 
-  std::string getDesc(const std::filesystem::directory_entry& playlistDir); 
-  std::string getUrl(const std::filesystem::directory_entry& playlistDir); 
-  std::string getThumbnailPath(const std::filesystem::directory_entry& playlistDir); 
+  // Reads name, description, url and thumbnail without touching the paths
+  bool readHeader(const std::filesystem::path& playlistDir, PlaylistHeader& header);
+  // Every path once, so the indices are the rows that moveFile() refers to
   std::vector<std::string> getFilepaths(const std::filesystem::directory_entry& playlistDir); 
-}
+  // O(1) through a hash set of the paths that every edit keeps up to date. Only the first
+  // check of a playlist reads its file.
+  bool containsFile(const std::filesystem::path& playlistDir, const std::string& path);
 
+  // Replaces the whole file through a temporary file and drops the journal. A path that is
+  // listed twice is only stored once.
+  bool write(const std::filesystem::path& playlistDir, const PlaylistHeader& header, const std::vector<std::string>& paths);
 
+  // Edits, each one is a single append to the journal. Paths are stored lexically normalized,
+  // so a file is found whatever spelling of its path is passed.
+  bool appendFiles(const std::filesystem::path& playlistDir, const std::vector<std::string>& paths);
+  bool appendFile(const std::filesystem::path& playlistDir, const std::string& path);
+  bool removeFile(const std::filesystem::path& playlistDir, const std::string& path);
+  // Moves the path at 'fromIndex' like dragging its row onto the one at 'toIndex'
+  bool moveFile(const std::filesystem::path& playlistDir, uint32_t fromIndex, uint32_t toIndex);
+  // Replaces name, description, url and thumbnail, 'fileCount' is ignored
+  bool setHeader(const std::filesystem::path& playlistDir, const PlaylistHeader& header);
+}
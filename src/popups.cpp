@@ -8,6 +8,7 @@
 #include <stb_image_write.h>
 
 #include "playlists.hpp"
+#include "processManager.hpp"
 #include "soundTagParser.hpp"
 
 #include <cstring>
@@ -120,22 +121,8 @@ void EditPlaylistPopup::render() {
     props.margin_top = 15;
     lf_push_style_props(props);
     if(lf_button_fixed("Done", 150, -1) == LF_CLICKED) {
-      std::vector<std::string> playlistFilepaths =  PlaylistMetadata::getFilepaths(std::filesystem::directory_entry(currentPlaylist.path));
-
       Playlist::rename(std::string(nameBuf), state.currentPlaylist);
       Playlist::changeDesc(std::string(descBuf), state.currentPlaylist);
-
-      bool playlistEmpty = currentPlaylist.musicFiles.empty();
-      if(playlistEmpty) {
-        for(auto& filepath : playlistFilepaths) {
-          currentPlaylist.musicFiles.emplace_back((SoundFile){.path = filepath});
-        }
-      }
-      Playlist::save(state.currentPlaylist);
-      if(playlistEmpty) {
-        currentPlaylist.musicFiles.clear();
-        currentPlaylist.musicFiles.shrink_to_fit();
-      }
       this->shouldRender = false;
 
       memset(nameBuf, 0, INPUT_BUFFER_SIZE);
@@ -222,12 +209,10 @@ void PlaylistFileDialoguePopup::render() {
         }
       case 1: /* Remove */
         {
-          if(state.currentSoundFile != nullptr) {
-            if(state.currentSoundFile->path == this->path) {
-              state.soundHandler.stop();
-              state.soundHandler.uninit();
-              state.currentSoundFile = nullptr;
-            }
+          if(state.currentTrack != INVALID_TRACK_ID && state.currentTrack == TrackLibrary::find(this->path)) {
+            state.soundHandler.stop();
+            state.soundHandler.uninit();
+            state.currentTrack = INVALID_TRACK_ID;
           }
           Playlist::removeFile(this->path, state.currentPlaylist);
           this->shouldRender = false;
@@ -238,18 +223,7 @@ void PlaylistFileDialoguePopup::render() {
       case 2: /* Add to favourites */
         {
           if(Playlist::metadataContainsFile(this->path.string(), 0)) {
-            Playlist& favourites = state.playlists[0];
-            if(!favourites.loaded) {
-              std::vector<std::string> paths = PlaylistMetadata::getFilepaths(
-                  std::filesystem::directory_entry(state.playlists[0].path));
-              for(auto& path : paths) {
-                favourites.musicFiles.push_back((SoundFile){.path = path});
-              }
-              Playlist::removeFile(this->path.string(), 0);
-              favourites.musicFiles.clear();
-            } else {
-              Playlist::removeFile(this->path.string(), 0);
-            }
+            Playlist::removeFile(this->path.string(), 0);
             this->shouldRender = false;
             lf_div_ungrab();
             state.infoCards.addCard("Removed from favourites.");
@@ -259,11 +233,7 @@ void PlaylistFileDialoguePopup::render() {
               Playlist::addFile(this->path, 0);
               favourites.loaded = false;
             } else {
-              std::ofstream metadata(favourites.path.string() + "/.metadata", std::ios::app);
-              metadata.seekp(0, std::ios::end);
-
-              metadata << "\"" << this->path.string() << "\" ";
-              metadata.close();
+              PlaylistMetadata::appendFile(favourites.path, this->path.string());
             }
             this->shouldRender = false;
             lf_div_ungrab();
@@ -273,13 +243,18 @@ void PlaylistFileDialoguePopup::render() {
         }
       case 3: /* Open URL */
         {
-          std::string url = SoundTagParser::getSoundComment(this->path.string());
-          if(url != "") {
-            std::string cmd = "xdg-open " + url + "& ";
-            system(cmd.c_str());
-          }
+          // The URL comes from the tags of the file, it is handed to xdg-open as an argument and never to a shell
+          std::string url = SoundTagParser::parse(this->path.string(), false).url;
           this->shouldRender = false;
           lf_div_ungrab();
+          if(url.rfind("https://", 0) != 0 && url.rfind("http://", 0) != 0) {
+            state.infoCards.addCard("The file has no web URL.");
+            break;
+          }
+          if(ProcessManager::spawn({"xdg-open", url}) == -1) {
+            state.infoCards.addCard("Failed to open URL.");
+            break;
+          }
           state.infoCards.addCard("Opening URL...");
           break;
         }
@@ -299,8 +274,7 @@ void PlaylistFileDialoguePopup::render() {
           playlist.thumbnail.width = fullscaleThumb.width;
           playlist.thumbnail.height = fullscaleThumb.height;
 
-          playlist.thumbnailPath = std::filesystem::path(playlist.path.string() + "/thumbnail.jpg.jpg");
-          Playlist::save(state.currentPlaylist);
+          Playlist::changeThumbnail(playlist.path.string() + "/thumbnail.jpg.jpg", state.currentPlaylist);
           this->shouldRender = false;
           lf_div_ungrab();
           state.infoCards.addCard("Changed thumbnail of playlist.");
@@ -344,11 +318,7 @@ void PlaylistFileDialoguePopup::render() {
           if(playlist.loaded) {
             Playlist::addFile(this->path, i);
           } else {
-            std::ofstream metadata(playlist.path.string() + "/.metadata", std::ios::app);
-            metadata.seekp(0, std::ios::end);
-
-            metadata << "\"" << this->path.string() << "\" ";
-            metadata.close();
+            PlaylistMetadata::appendFile(playlist.path, this->path.string());
           }
           playlist.loaded = false;
           this->shouldRender = false;
@@ -0,0 +1,283 @@
+#include "processManager.hpp"
+#include "config.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <unordered_map>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+struct ChildProcess {
+  // -1 on kernels without pidfd_open, those children are checked with waitpid every update
+  int pidfd;
+  // Read end of the stdout pipe, -1 if the output is not captured
+  int outputFd;
+  std::string output;
+  std::function<void(int32_t exitCode)> onExit;
+  std::function<void(const std::string& line)> onLine;
+};
+
+// What an epoll event of a child refers to, stored in the upper half of the event data
+enum class ChildEvent : uint32_t {
+  Exit = 0,
+  Output
+};
+
+// A child that got SIGTERM and was not reaped yet, its callbacks are gone already
+struct TerminatingProcess {
+  pid_t pid;
+  std::chrono::steady_clock::time_point killDeadline;
+  bool killed;
+};
+
+static std::unordered_map<pid_t, ChildProcess> children;
+static std::vector<TerminatingProcess> terminating;
+static int epollFd = -1;
+
+static uint64_t eventData(ChildEvent event, pid_t pid) {
+  return ((uint64_t)event << 32) | (uint32_t)pid;
+}
+
+static void watch(int fd, ChildEvent event, pid_t pid) {
+  epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.u64 = eventData(event, pid);
+  epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+// Reads everything the child wrote so far and hands out the complete lines
+static void readOutput(ChildProcess& child) {
+  if(child.outputFd == -1) return;
+  char buffer[4096];
+  while(true) {
+    ssize_t n = read(child.outputFd, buffer, sizeof(buffer));
+    if(n <= 0) break;
+    child.output.append(buffer, n);
+  }
+  size_t start = 0, end;
+  while((end = child.output.find('\n', start)) != std::string::npos) {
+    // yt-dlp redraws its progress with carriage returns
+    std::string line = child.output.substr(start, end - start);
+    if(!line.empty() && line.back() == '\r') line.pop_back();
+    if(child.onLine) child.onLine(line);
+    start = end + 1;
+  }
+  child.output.erase(0, start);
+}
+
+static int openPidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+  return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+  (void)pid;
+  return -1;
+#endif
+}
+
+// Returns true if the child exited and was reaped
+static bool reap(pid_t pid, int32_t& exitCode) {
+  int status;
+  pid_t ret = waitpid(pid, &status, WNOHANG);
+  if(ret == 0) return false;
+  if(ret == -1) {
+    // Somebody else reaped it already
+    exitCode = -1;
+    return true;
+  }
+  exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+  return true;
+}
+
+static void forget(pid_t pid) {
+  auto it = children.find(pid);
+  if(it == children.end()) return;
+  if(it->second.pidfd != -1) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, it->second.pidfd, nullptr);
+    close(it->second.pidfd);
+  }
+  if(it->second.outputFd != -1) {
+    if(epollFd != -1) epoll_ctl(epollFd, EPOLL_CTL_DEL, it->second.outputFd, nullptr);
+    close(it->second.outputFd);
+  }
+  children.erase(it);
+}
+
+// Reaps the terminated children that exited, the ones that ignore SIGTERM get SIGKILL
+static void reapTerminating() {
+  auto now = std::chrono::steady_clock::now();
+  for(size_t i = 0; i < terminating.size();) {
+    TerminatingProcess& process = terminating[i];
+    int32_t exitCode;
+    if(reap(process.pid, exitCode)) {
+      terminating[i] = terminating.back();
+      terminating.pop_back();
+      continue;
+    }
+    if(!process.killed && now >= process.killDeadline) {
+      ::kill(-process.pid, SIGKILL);
+      process.killed = true;
+    }
+    i++;
+  }
+}
+
+namespace ProcessManager {
+  void init() {
+    if(epollFd != -1) return;
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if(epollFd == -1) {
+      LOG_ERROR("Failed to create the child process epoll set: %s\n", strerror(errno));
+    }
+  }
+
+  void shutdown() {
+    std::vector<pid_t> pids;
+    for(auto& [pid, child] : children) {
+      pids.emplace_back(pid);
+    }
+    for(pid_t pid : pids) {
+      terminate(pid);
+    }
+    // Gives them the same time as while running, SIGKILL can not be ignored
+    while(!terminating.empty()) {
+      reapTerminating();
+      bool allKilled = std::all_of(terminating.begin(), terminating.end(),
+          [](const TerminatingProcess& process) { return process.killed; });
+      if(allKilled) {
+        for(TerminatingProcess& process : terminating) {
+          waitpid(process.pid, nullptr, 0);
+        }
+        terminating.clear();
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    if(epollFd != -1) {
+      close(epollFd);
+      epollFd = -1;
+    }
+  }
+
+  pid_t spawn(const std::vector<std::string>& argv, const std::function<void(int32_t exitCode)>& onExit,
+      const std::function<void(const std::string& line)>& onLine) {
+    if(argv.empty()) return -1;
+
+    std::vector<char*> args;
+    for(auto& arg : argv) {
+      args.emplace_back((char*)arg.c_str());
+    }
+    args.emplace_back(nullptr);
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    // Its own process group, so terminate() also reaches the processes it starts
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+
+    // The child writes into the pipe as its stdout, dup2 clears O_CLOEXEC on that copy
+    int outputPipe[2] = {-1, -1};
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if(onLine) {
+      if(pipe2(outputPipe, O_CLOEXEC | O_NONBLOCK) != 0) {
+        LOG_ERROR("Failed to create the output pipe for '%s': %s\n", args[0], strerror(errno));
+        outputPipe[0] = outputPipe[1] = -1;
+      } else {
+        posix_spawn_file_actions_adddup2(&actions, outputPipe[1], STDOUT_FILENO);
+      }
+    }
+
+    pid_t pid;
+    int err = posix_spawnp(&pid, args[0], &actions, &attr, args.data(), environ);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    if(outputPipe[1] != -1) close(outputPipe[1]);
+    if(err != 0) {
+      LOG_ERROR("Failed to start '%s': %s\n", args[0], strerror(err));
+      if(outputPipe[0] != -1) close(outputPipe[0]);
+      return -1;
+    }
+
+    ChildProcess child = {
+      .pidfd = epollFd != -1 ? openPidfd(pid) : -1, 
+      .outputFd = outputPipe[0],
+      .output = "",
+      .onExit = onExit, 
+      .onLine = onLine
+    };
+    if(child.pidfd != -1) 
+      watch(child.pidfd, ChildEvent::Exit, pid);
+    if(child.outputFd != -1 && epollFd != -1) 
+      watch(child.outputFd, ChildEvent::Output, pid);
+    children[pid] = child;
+    return pid;
+  }
+
+  void terminate(pid_t pid) {
+    if(children.find(pid) == children.end()) return;
+    ::kill(-pid, SIGTERM);
+    // Never waits here, update() reaps it and escalates to SIGKILL if it does not exit in time
+    forget(pid);
+    terminating.emplace_back((TerminatingProcess){
+        .pid = pid,
+        .killDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(PROCESS_TERMINATE_TIMEOUT_MS),
+        .killed = false
+        });
+  }
+
+  bool isRunning(pid_t pid) {
+    return pid != -1 && children.find(pid) != children.end();
+  }
+
+  void update() {
+    if(!terminating.empty()) reapTerminating();
+    if(children.empty()) return;
+
+    std::vector<pid_t> exited;
+    if(epollFd != -1) {
+      epoll_event events[32];
+      int count = epoll_wait(epollFd, events, 32, 0);
+      for(int i = 0; i < count; i++) {
+        pid_t pid = (pid_t)(uint32_t)events[i].data.u64;
+        if((ChildEvent)(events[i].data.u64 >> 32) == ChildEvent::Exit) {
+          exited.emplace_back(pid);
+          continue;
+        }
+        auto it = children.find(pid);
+        if(it != children.end()) readOutput(it->second);
+      }
+    }
+    for(auto& [pid, child] : children) {
+      if(child.pidfd != -1) continue;
+      // Without an epoll set the output is read here as well
+      if(epollFd == -1) readOutput(child);
+      exited.emplace_back(pid);
+    }
+
+    for(pid_t pid : exited) {
+      int32_t exitCode;
+      if(!reap(pid, exitCode)) continue;
+      auto it = children.find(pid);
+      if(it == children.end()) continue;
+      // Whatever the child wrote last, the write end is closed now
+      readOutput(it->second);
+      if(!it->second.output.empty() && it->second.onLine) it->second.onLine(it->second.output);
+      std::function<void(int32_t)> onExit = it->second.onExit;
+      forget(pid);
+      // The callback may start new children
+      if(onExit) onExit(exitCode);
+    }
+  }
+}
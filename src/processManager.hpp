@@ -0,0 +1,32 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// Child processes (yt-dlp downloads) started with posix_spawn. Every child gets its own
+// process group, so terminating it also stops whatever it started. Exits and output are
+// picked up by update() through pidfds and pipes in an epoll set and reported as callbacks,
+// nothing is polled by forking. Main thread only.
+namespace ProcessManager {
+  void init();
+  // Terminates every child that is still running and waits for them, their callbacks are not called
+  void shutdown();
+
+  // Starts argv[0] (looked up in PATH). 'onExit' gets the exit code, or -1 if the child
+  // was killed by a signal. If 'onLine' is set, the stdout of the child is read through a
+  // pipe and handed to it line by line, all lines arrive before 'onExit' is called.
+  // Returns -1 if the process could not be started.
+  pid_t spawn(const std::vector<std::string>& argv, const std::function<void(int32_t exitCode)>& onExit = nullptr,
+      const std::function<void(const std::string& line)>& onLine = nullptr);
+  // Sends SIGTERM to the process group of the child and drops its callbacks. Does not wait,
+  // update() reaps the child and sends SIGKILL after PROCESS_TERMINATE_TIMEOUT_MS.
+  void terminate(pid_t pid);
+  bool isRunning(pid_t pid);
+
+  // Reaps exited and terminated children and calls the callbacks of the exited ones. Once per frame.
+  void update();
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+
+// Lock-free single-producer/single-consumer ring of interleaved float frames.
+// write() must only be called from one thread and read() from one other thread.
+// Positions are absolute frame counts that never wrap, so the consumer can
+// compare its read position with positions the producer handed out earlier.
+class PcmRingBuffer {
+  public:
+    void init(uint64_t capacityFrames, uint32_t channels) {
+      uint64_t capacity = 1;
+      while(capacity < capacityFrames) capacity <<= 1;
+      _capacity = capacity;
+      _channels = channels;
+      _data.assign(capacity * channels, 0.0f);
+      reset();
+    }
+
+    // Must only be called while neither the producer nor the consumer is running
+    void reset() {
+      _readPos.store(0);
+      _writePos.store(0);
+    }
+
+    uint64_t availableRead() const {
+      return _writePos.load(std::memory_order_acquire) - _readPos.load(std::memory_order_relaxed);
+    }
+    uint64_t availableWrite() const {
+      return _capacity - (_writePos.load(std::memory_order_relaxed) - _readPos.load(std::memory_order_acquire));
+    }
+
+    uint64_t write(const float* frames, uint64_t frameCount) {
+      uint64_t pos = _writePos.load(std::memory_order_relaxed);
+      uint64_t count = std::min(frameCount, availableWrite());
+      copy(pos, count, [&](uint64_t offset, uint64_t src, uint64_t n) {
+          memcpy(&_data[offset * _channels], frames + src * _channels, n * _channels * sizeof(float));
+          });
+      _writePos.store(pos + count, std::memory_order_release);
+      return count;
+    }
+
+    uint64_t read(float* frames, uint64_t frameCount) {
+      uint64_t pos = _readPos.load(std::memory_order_relaxed);
+      uint64_t count = std::min(frameCount, availableRead());
+      copy(pos, count, [&](uint64_t offset, uint64_t dst, uint64_t n) {
+          memcpy(frames + dst * _channels, &_data[offset * _channels], n * _channels * sizeof(float));
+          });
+      _readPos.store(pos + count, std::memory_order_release);
+      return count;
+    }
+
+    uint64_t getReadPos() const { return _readPos.load(std::memory_order_acquire); }
+    uint64_t getWritePos() const { return _writePos.load(std::memory_order_acquire); }
+    uint64_t getCapacity() const { return _capacity; }
+
+  private:
+    // Splits [pos, pos + count) at the end of the storage
+    template<typename Fn>
+    void copy(uint64_t pos, uint64_t count, Fn fn) {
+      uint64_t offset = pos & (_capacity - 1);
+      uint64_t first = std::min(count, _capacity - offset);
+      if(first) fn(offset, 0, first);
+      if(count > first) fn(0, first, count - first);
+    }
+
+    std::vector<float> _data;
+    uint64_t _capacity = 0;
+    uint32_t _channels = 0;
+    std::atomic<uint64_t> _readPos{0}, _writePos{0};
+};
+
+// Lock-free single-producer/single-consumer queue of at most N - 1 elements.
+template<typename T, uint32_t N>
+class SpscQueue {
+  public:
+    bool push(const T& item) {
+      uint32_t tail = _tail.load(std::memory_order_relaxed);
+      uint32_t nextTail = (tail + 1) % N;
+      if(nextTail == _head.load(std::memory_order_acquire)) return false;
+      _items[tail] = item;
+      _tail.store(nextTail, std::memory_order_release);
+      return true;
+    }
+    bool peek(T& item) const {
+      uint32_t head = _head.load(std::memory_order_relaxed);
+      if(head == _tail.load(std::memory_order_acquire)) return false;
+      item = _items[head];
+      return true;
+    }
+    void pop() {
+      uint32_t head = _head.load(std::memory_order_relaxed);
+      if(head == _tail.load(std::memory_order_acquire)) return;
+      _head.store((head + 1) % N, std::memory_order_release);
+    }
+    bool empty() const {
+      return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+    bool full() const {
+      return (_tail.load(std::memory_order_acquire) + 1) % N == _head.load(std::memory_order_acquire);
+    }
+    // Must only be called while neither the producer nor the consumer is running
+    void clear() {
+      _head.store(0);
+      _tail.store(0);
+    }
+  private:
+    T _items[N];
+    std::atomic<uint32_t> _head{0}, _tail{0};
+};
+
+// Lock-free multi-producer/single-consumer queue without a size limit.
+// push() may be called from any thread, drain() only from the one consumer thread.
+template<typename T>
+class MpscQueue {
+  public:
+    ~MpscQueue() {
+      drain([](T&&){});
+    }
+
+    void push(T item) {
+      Node* node = new Node{std::move(item), _head.load(std::memory_order_relaxed)};
+      while(!_head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // Hands every item pushed so far to 'fn' in push order and returns the item count
+    template<typename Fn>
+    uint32_t drain(Fn fn) {
+      Node* node = _head.exchange(nullptr, std::memory_order_acquire);
+      // The producers build a stack, the newest item comes first
+      Node* oldest = nullptr;
+      while(node) {
+        Node* next = node->next;
+        node->next = oldest;
+        oldest = node;
+        node = next;
+      }
+      uint32_t count = 0;
+      while(oldest) {
+        Node* next = oldest->next;
+        fn(std::move(oldest->item));
+        delete oldest;
+        oldest = next;
+        count++;
+      }
+      return count;
+    }
+
+    bool empty() const {
+      return _head.load(std::memory_order_acquire) == nullptr;
+    }
+  private:
+    struct Node {
+      T item;
+      Node* next;
+    };
+    std::atomic<Node*> _head{nullptr};
+};
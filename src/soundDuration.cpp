@@ -0,0 +1,277 @@
+#include "soundDuration.hpp"
+#include "config.hpp"
+#include "log.hpp"
+
+#include <miniaudio.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+#include <string.h>
+
+struct DurationCacheEntry {
+  uintmax_t size;
+  std::filesystem::file_time_type mtime;
+  double duration;
+};
+
+static std::unordered_map<std::string, DurationCacheEntry> durationCache;
+static std::mutex durationCacheMutex;
+
+static uint32_t readBE32(const uint8_t* p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+static uint16_t readLE16(const uint8_t* p) {
+  return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+static uint32_t readLE32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+static uint64_t readLE64(const uint8_t* p) {
+  return (uint64_t)readLE32(p) | ((uint64_t)readLE32(p + 4) << 32);
+}
+
+static std::vector<uint8_t> readBytes(std::ifstream& file, uint64_t offset, uint64_t count) {
+  std::vector<uint8_t> bytes(count);
+  file.clear();
+  file.seekg(offset);
+  file.read((char*)bytes.data(), count);
+  bytes.resize(file.gcount());
+  return bytes;
+}
+
+// Size of the ID3v2 tag at the start of the file (0 if there is none)
+static uint64_t getID3v2Size(std::ifstream& file) {
+  std::vector<uint8_t> header = readBytes(file, 0, 10);
+  if(header.size() < 10 || memcmp(header.data(), "ID3", 3) != 0) return 0;
+  uint64_t size = ((uint64_t)(header[6] & 0x7F) << 21) | ((uint64_t)(header[7] & 0x7F) << 14) |
+    ((uint64_t)(header[8] & 0x7F) << 7) | (uint64_t)(header[9] & 0x7F);
+  // Footer present
+  if(header[5] & 0x10) size += 10;
+  return size + 10;
+}
+
+struct MpegFrameHeader {
+  uint32_t bitrate, sampleRate, samplesPerFrame, frameLength;
+  bool mpeg1, mono;
+};
+
+static bool parseMpegFrameHeader(const uint8_t* p, MpegFrameHeader& header) {
+  static const uint16_t bitratesV1[3][15] = {
+    {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448}, // Layer I
+    {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},    // Layer II
+    {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},     // Layer III
+  };
+  static const uint16_t bitratesV2[3][15] = {
+    {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},
+    {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+    {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+  };
+  static const uint32_t sampleRates[3] = {44100, 48000, 32000};
+
+  if(p[0] != 0xFF || (p[1] & 0xE0) != 0xE0) return false;
+  uint32_t version = (p[1] >> 3) & 0x03;  // 0: MPEG 2.5, 2: MPEG 2, 3: MPEG 1
+  uint32_t layerBits = (p[1] >> 1) & 0x03; // 1: Layer III, 2: Layer II, 3: Layer I
+  uint32_t bitrateIndex = (p[2] >> 4) & 0x0F;
+  uint32_t sampleRateIndex = (p[2] >> 2) & 0x03;
+  if(version == 1 || layerBits == 0 || bitrateIndex == 0 || bitrateIndex == 15 || sampleRateIndex == 3)
+    return false;
+
+  uint32_t layer = 4 - layerBits;
+  header.mpeg1 = version == 3;
+  header.mono = ((p[3] >> 6) & 0x03) == 3;
+  header.bitrate = (header.mpeg1 ? bitratesV1 : bitratesV2)[layer - 1][bitrateIndex] * 1000;
+  header.sampleRate = sampleRates[sampleRateIndex] >> (version == 3 ? 0 : (version == 2 ? 1 : 2));
+
+  uint32_t padding = (p[2] >> 1) & 0x01;
+  if(layer == 1) {
+    header.samplesPerFrame = 384;
+    header.frameLength = (12 * header.bitrate / header.sampleRate + padding) * 4;
+  } else if(layer == 2 || header.mpeg1) {
+    header.samplesPerFrame = 1152;
+    header.frameLength = 144 * header.bitrate / header.sampleRate + padding;
+  } else {
+    header.samplesPerFrame = 576;
+    header.frameLength = 72 * header.bitrate / header.sampleRate + padding;
+  }
+  return header.frameLength > 4;
+}
+
+static double getMp3Duration(std::ifstream& file, uint64_t fileSize) {
+  uint64_t audioStart = getID3v2Size(file);
+  std::vector<uint8_t> data = readBytes(file, audioStart, SOUND_DURATION_PROBE_BYTES);
+
+  // Find the first frame, a sync is only accepted if the following frame syncs as well
+  MpegFrameHeader header;
+  uint64_t framePos = 0;
+  bool found = false;
+  for(; framePos + 4 <= data.size(); framePos++) {
+    if(!parseMpegFrameHeader(&data[framePos], header)) continue;
+    uint64_t nextPos = framePos + header.frameLength;
+    MpegFrameHeader nextHeader;
+    if(nextPos + 4 > data.size() || parseMpegFrameHeader(&data[nextPos], nextHeader)) {
+      found = true;
+      break;
+    }
+  }
+  if(!found) return -1.0;
+  const uint8_t* frame = &data[framePos];
+  uint64_t frameEnd = data.size() - framePos;
+
+  // Xing/Info header right after the side information
+  uint32_t xingOffset = 4 + (header.mpeg1 ? (header.mono ? 17 : 32) : (header.mono ? 9 : 17));
+  if(xingOffset + 8 <= frameEnd &&
+      (memcmp(frame + xingOffset, "Xing", 4) == 0 || memcmp(frame + xingOffset, "Info", 4) == 0)) {
+    uint32_t flags = readBE32(frame + xingOffset + 4);
+    uint64_t pos = xingOffset + 8;
+    uint32_t frameCount = 0;
+    if(flags & 0x01) {
+      if(pos + 4 > frameEnd) return -1.0;
+      frameCount = readBE32(frame + pos);
+      pos += 4;
+    }
+    if(flags & 0x02) pos += 4;   // Byte count
+    if(flags & 0x04) pos += 100; // Seek table
+    if(flags & 0x08) pos += 4;   // Quality
+
+    if(frameCount != 0) {
+      uint64_t samples = (uint64_t)frameCount * header.samplesPerFrame;
+      // LAME stores the encoder delay and padding in 12 bits each
+      if(pos + 24 <= frameEnd && memcmp(frame + pos, "LAME", 4) == 0) {
+        const uint8_t* delayPadding = frame + pos + 21;
+        uint64_t delay = ((uint64_t)delayPadding[0] << 4) | (delayPadding[1] >> 4);
+        uint64_t padding = ((uint64_t)(delayPadding[1] & 0x0F) << 8) | delayPadding[2];
+        if(delay + padding < samples) samples -= delay + padding;
+      }
+      return (double)samples / header.sampleRate;
+    }
+  }
+
+  // VBRI header at a fixed offset
+  if(36 + 18 <= frameEnd && memcmp(frame + 36, "VBRI", 4) == 0) {
+    uint32_t frameCount = readBE32(frame + 36 + 14);
+    if(frameCount != 0)
+      return (double)((uint64_t)frameCount * header.samplesPerFrame) / header.sampleRate;
+  }
+
+  // Constant bitrate, estimate from the size of the audio data
+  uint64_t audioEnd = fileSize;
+  std::vector<uint8_t> id3v1 = readBytes(file, fileSize >= 128 ? fileSize - 128 : 0, 128);
+  if(id3v1.size() == 128 && memcmp(id3v1.data(), "TAG", 3) == 0) audioEnd -= 128;
+  uint64_t audioSize = audioEnd > audioStart + framePos ? audioEnd - audioStart - framePos : 0;
+  return (double)audioSize * 8.0 / header.bitrate;
+}
+
+static double getFlacDuration(std::ifstream& file) {
+  uint64_t start = getID3v2Size(file);
+  // "fLaC", metadata block header, then STREAMINFO which is always the first block
+  std::vector<uint8_t> data = readBytes(file, start, 4 + 4 + 34);
+  if(data.size() < 42 || memcmp(data.data(), "fLaC", 4) != 0 || (data[4] & 0x7F) != 0) return -1.0;
+
+  const uint8_t* info = &data[8 + 10];
+  uint32_t sampleRate = ((uint32_t)info[0] << 12) | ((uint32_t)info[1] << 4) | (info[2] >> 4);
+  uint64_t totalSamples = ((uint64_t)(info[3] & 0x0F) << 32) | ((uint64_t)info[4] << 24) |
+    ((uint64_t)info[5] << 16) | ((uint64_t)info[6] << 8) | (uint64_t)info[7];
+  // A total of 0 means unknown
+  if(sampleRate == 0 || totalSamples == 0) return -1.0;
+  return (double)totalSamples / sampleRate;
+}
+
+static double getOggDuration(std::ifstream& file, uint64_t fileSize) {
+  // The first page carries the identification header of the codec
+  std::vector<uint8_t> first = readBytes(file, 0, 27 + 255 + 64);
+  if(first.size() < 28 || memcmp(first.data(), "OggS", 4) != 0) return -1.0;
+  uint64_t packetPos = 27 + first[26];
+  if(packetPos + 19 > first.size()) return -1.0;
+  const uint8_t* packet = &first[packetPos];
+
+  uint32_t sampleRate = 0;
+  uint64_t preSkip = 0;
+  if(memcmp(packet, "\x01vorbis", 7) == 0) {
+    sampleRate = readLE32(packet + 12);
+  } else if(memcmp(packet, "OpusHead", 8) == 0) {
+    // Opus granule positions always count at 48kHz
+    sampleRate = 48000;
+    preSkip = readLE16(packet + 10);
+  } else {
+    return -1.0;
+  }
+  if(sampleRate == 0) return -1.0;
+
+  // The granule position of the last page is the total sample count
+  uint64_t tailSize = std::min<uint64_t>(fileSize, SOUND_DURATION_PROBE_BYTES);
+  std::vector<uint8_t> tail = readBytes(file, fileSize - tailSize, tailSize);
+  for(int64_t i = (int64_t)tail.size() - 14; i >= 0; i--) {
+    if(memcmp(&tail[i], "OggS", 4) != 0) continue;
+    uint64_t granule = readLE64(&tail[i + 6]);
+    if(granule == UINT64_MAX || granule <= preSkip) continue;
+    return (double)(granule - preSkip) / sampleRate;
+  }
+  return -1.0;
+}
+
+namespace SoundDuration {
+  double get(const std::string& soundPath) {
+    std::error_code ec;
+    uintmax_t size = std::filesystem::file_size(soundPath, ec);
+    if(ec) return 0.0;
+    std::filesystem::file_time_type mtime = std::filesystem::last_write_time(soundPath, ec);
+    if(ec) return 0.0;
+
+    {
+      std::lock_guard<std::mutex> lock(durationCacheMutex);
+      auto it = durationCache.find(soundPath);
+      if(it != durationCache.end() && it->second.size == size && it->second.mtime == mtime)
+        return it->second.duration;
+    }
+
+    double duration = fromHeaders(soundPath);
+    if(duration < 0.0)
+      duration = fromDecoder(soundPath);
+
+    std::lock_guard<std::mutex> lock(durationCacheMutex);
+    durationCache[soundPath] = (DurationCacheEntry){.size = size, .mtime = mtime, .duration = duration};
+    return duration;
+  }
+
+  double fromHeaders(const std::string& soundPath) {
+    std::ifstream file(soundPath, std::ios::binary);
+    if(!file.is_open()) return -1.0;
+    file.seekg(0, std::ios::end);
+    uint64_t fileSize = file.tellg();
+
+    std::vector<uint8_t> magic = readBytes(file, 0, 4);
+    if(magic.size() < 4) return -1.0;
+    if(memcmp(magic.data(), "OggS", 4) == 0)
+      return getOggDuration(file, fileSize);
+    if(memcmp(magic.data(), "fLaC", 4) == 0)
+      return getFlacDuration(file);
+
+    std::string extension = std::filesystem::path(soundPath).extension().string();
+    if(extension == ".flac")
+      return getFlacDuration(file);
+    if(extension == ".mp3" || memcmp(magic.data(), "ID3", 3) == 0)
+      return getMp3Duration(file, fileSize);
+    return -1.0;
+  }
+
+  double fromDecoder(const std::string& soundPath) {
+    // Decode at the native format so no resampler runs while measuring
+    ma_decoder_config config = ma_decoder_config_init(ma_format_unknown, 0, 0);
+    ma_decoder decoder;
+    if(ma_decoder_init_file(soundPath.c_str(), &config, &decoder) != MA_SUCCESS) {
+      LOG_ERROR("Failed to open '%s' to get its duration.\n", soundPath.c_str());
+      return 0.0;
+    }
+    ma_uint64 lengthInFrames = 0;
+    ma_decoder_get_length_in_pcm_frames(&decoder, &lengthInFrames);
+    double duration = decoder.outputSampleRate ? (double)lengthInFrames / decoder.outputSampleRate : 0.0;
+    ma_decoder_uninit(&decoder);
+    return duration;
+  }
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+
+// Reads the duration of a sound file from its headers without opening a playback device.
+// MP3 uses the Xing/Info (with LAME delay and padding) or VBRI header and falls back to a
+// constant bitrate estimate, FLAC uses STREAMINFO and Ogg Vorbis/Opus use the granule position
+// of the last page. Every other format is measured with a decoder (no device).
+// Results are cached by path, file size and modification time.
+namespace SoundDuration {
+  double get(const std::string& soundPath);
+
+  double fromHeaders(const std::string& soundPath);
+  double fromDecoder(const std::string& soundPath);
+}
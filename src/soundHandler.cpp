@@ -1,11 +1,323 @@
 #include "soundHandler.hpp"
 
 #include "global.hpp"
+#include "soundDuration.hpp"
 
-double SoundHandler::getSoundDuration(const std::string &soundPath) {
-  SoundHandler sound; 
-  sound.init(soundPath, miniaudioDataCallback);
-  double duration = sound.lengthInSeconds;
-  sound.uninit();
-  return duration;
+#include <algorithm>
+#include <string.h>
+
+SoundHandler::~SoundHandler() {
+  shutdown();
+}
+
+void SoundHandler::init(const std::string& filepath, ma_device_data_proc dataCallback) {
+  std::lock_guard<std::mutex> lock(audioMutex);
+  if(!deviceInit) {
+    // The device is opened once at a fixed format, every decoder converts to it
+    ma_device_config deviceConfig = ma_device_config_init(ma_device_type_playback);
+    deviceConfig.playback.format    = SOUND_OUTPUT_FORMAT;
+    deviceConfig.playback.channels  = SOUND_OUTPUT_CHANNELS;
+    deviceConfig.sampleRate         = SOUND_OUTPUT_SAMPLE_RATE;
+    deviceConfig.dataCallback       = dataCallback;
+    deviceConfig.pUserData          = this;
+
+    if (ma_device_init(NULL, &deviceConfig, &this->device) != MA_SUCCESS) {
+      LOG_ERROR("Failed to initialize the playback device.\n");
+      return;
+    }
+    deviceInit = true;
+
+    ring.init(SOUND_DECODE_AHEAD_FRAMES, SOUND_OUTPUT_CHANNELS);
+    decodeBuffer.resize(SOUND_DECODE_CHUNK_FRAMES * SOUND_OUTPUT_CHANNELS);
+    decoderRunning = true;
+    decoderThread = std::thread(&SoundHandler::decodeLoop, this);
+  }
+
+  // The data callback must not run while the current sound is replaced
+  if(ma_device_is_started(&this->device))
+    ma_device_stop(&this->device);
+  isPlaying = false;
+
+  SoundStream* stream = nullptr;
+  if(preloadPath == filepath) {
+    if(preloadFuture.valid())
+      preloadFuture.wait();
+    stream = next.exchange(nullptr);
+  }
+  cancelPreload();
+
+  if(!stream)
+    stream = openStream(filepath);
+
+  {
+    std::lock_guard<std::mutex> decoderLock(decoderMutex);
+    closeStream(current);
+    for(SoundStream* retired : retiredStreams) 
+      closeStream(retired);
+    retiredStreams.clear();
+    resetPlayback(stream, 0);
+  }
+  decoderWake.notify_one();
+
+  if(!stream) {
+    LOG_ERROR("Failed to load Sound '%s'.\n", filepath.c_str());
+    isInit = false;
+    return;
+  }
+
+  this->path = filepath;
+  lengthInSeconds = stream->lengthInSeconds;
+  isInit = true;
+}
+
+void SoundHandler::uninit() {
+  std::lock_guard<std::mutex> lock(audioMutex);
+  cancelPreload();
+  if(!this->isInit) return;
+  if(ma_device_is_started(&this->device))
+    ma_device_stop(&this->device);
+  isPlaying = false;
+
+  std::lock_guard<std::mutex> decoderLock(decoderMutex);
+  closeStream(current);
+  for(SoundStream* retired : retiredStreams) 
+    closeStream(retired);
+  retiredStreams.clear();
+  resetPlayback(nullptr, 0);
+  isInit = false;
+}
+
+void SoundHandler::shutdown() {
+  uninit();
+  std::lock_guard<std::mutex> lock(audioMutex);
+  if(!deviceInit) return;
+
+  decoderRunning = false;
+  decoderWake.notify_one();
+  decoderThread.join();
+
+  ma_device_uninit(&this->device);
+  deviceInit = false;
+}
+
+void SoundHandler::play() {
+  std::lock_guard<std::mutex> lock(audioMutex);
+  if(this->isPlaying || !this->isInit) return;
+  ma_device_start(&this->device);
+  isPlaying = true;
+}
+
+void SoundHandler::stop() {
+  std::lock_guard<std::mutex> lock(audioMutex);
+  if(!this->isPlaying) return;
+  ma_device_stop(&this->device);
+  isPlaying = false;
+}
+
+double SoundHandler::getPositionInSeconds() {
+  if(!isInit) return 0.0;
+  return (double)playedFrames.load() / SOUND_OUTPUT_SAMPLE_RATE;
+}
+
+void SoundHandler::setPositionInSeconds(double position) {
+  std::lock_guard<std::mutex> lock(audioMutex);
+  if(!isInit) return;
+  ma_uint64 targetFrame = (ma_uint64)(position * SOUND_OUTPUT_SAMPLE_RATE);
+
+  // Stop the device before seeking
+  if(isPlaying)
+    ma_device_stop(&this->device);
+
+  {
+    std::lock_guard<std::mutex> decoderLock(decoderMutex);
+    SoundStream* stream = playing.load();
+    if(stream != current) {
+      // The decoder thread already continued with the next sound, 
+      // hand that one back to the preload slot and decode the audible one again.
+      retiredStreams.erase(std::remove(retiredStreams.begin(), retiredStreams.end(), stream), retiredStreams.end());
+      ma_decoder_seek_to_pcm_frame(&current->decoder, 0);
+      closeStream(next.exchange(current));
+    }
+
+    if(ma_decoder_seek_to_pcm_frame(&stream->decoder, targetFrame) != MA_SUCCESS) {
+      LOG_ERROR("Sound position in seconds invalid.\n");
+    }
+    resetPlayback(stream, targetFrame);
+  }
+
+  if(isPlaying)
+    ma_device_start(&this->device);
+}
+
+void SoundHandler::preloadNext(const std::string& filepath) {
+  if(preloadPath == filepath && (preloadFuture.valid() || next.load())) return;
+  cancelPreload();
+  preloadPath = filepath;
+  preloadFuture = std::async(std::launch::async, [this, filepath](){
+      SoundStream* stream = openStream(filepath);
+      if(!stream) {
+        LOG_ERROR("Failed to preload Sound '%s'.\n", filepath.c_str());
+        return;
+      }
+      closeStream(next.exchange(stream));
+      decoderWake.notify_one();
+      });
+}
+
+void SoundHandler::cancelPreload() {
+  if(preloadFuture.valid())
+    preloadFuture.get();
+  closeStream(next.exchange(nullptr));
+  preloadPath.clear();
+}
+
+bool SoundHandler::hasPreloaded() {
+  return next.load() != nullptr || !boundaries.empty();
+}
+
+bool SoundHandler::pollEndOfStream() {
+  return endOfStream.exchange(false);
+}
+
+bool SoundHandler::pollTrackSwitch() {
+  if(!trackSwitched.exchange(false)) return false;
+  std::lock_guard<std::mutex> lock(audioMutex);
+  // Anything preloaded up to now was chosen relative to the previous sound
+  cancelPreload();
+
+  std::lock_guard<std::mutex> decoderLock(decoderMutex);
+  SoundStream* stream = playing.load();
+
+  // Everything that was decoded before the audible sound can be closed now
+  for(auto it = retiredStreams.begin(); it != retiredStreams.end();) {
+    if(*it != stream) {
+      closeStream(*it);
+      it = retiredStreams.erase(it);
+    } else {
+      it++;
+    }
+  }
+
+  this->path = stream->path;
+  lengthInSeconds = stream->lengthInSeconds;
+  return true;
+}
+
+void SoundHandler::readFrames(float* output, ma_uint32 frameCount) {
+  ma_uint64 framesRead = 0;
+  while(framesRead < frameCount) {
+    ma_uint64 framesToRead = frameCount - framesRead;
+
+    // Frames up to the next boundary still belong to the sound that is audible right now
+    SoundBoundary boundary;
+    if(boundaries.peek(boundary)) {
+      uint64_t readPos = ring.getReadPos();
+      if(boundary.position <= readPos) {
+        boundaries.pop();
+        playing.store(boundary.stream);
+        playedFrames.store(0);
+        trackSwitched.store(true);
+        endOfStreamPosted = false;
+        continue;
+      }
+      framesToRead = std::min<ma_uint64>(framesToRead, boundary.position - readPos);
+    }
+
+    ma_uint64 framesCopied = ring.read(output + framesRead * SOUND_OUTPUT_CHANNELS, framesToRead);
+    framesRead += framesCopied;
+    playedFrames.fetch_add(framesCopied);
+    if(framesCopied < framesToRead) break;
+  }
+
+  if(framesRead < frameCount && playing.load()) {
+    if(!streamEnded.load()) {
+      underruns.fetch_add(1);
+    } else if(boundaries.empty() && !endOfStreamPosted) {
+      // The last frame of the sound was just played and nothing follows it
+      endOfStreamPosted = true;
+      endOfStream.store(true);
+    }
+  }
+  if(framesRead < frameCount) {
+    memset(output + framesRead * SOUND_OUTPUT_CHANNELS, 0,
+        (frameCount - framesRead) * SOUND_OUTPUT_CHANNELS * sizeof(float));
+  }
+}
+
+void SoundHandler::decodeLoop() {
+  std::unique_lock<std::mutex> lock(decoderMutex);
+  while(decoderRunning) {
+    if(!decodeChunk()) {
+      decoderWake.wait_for(lock, std::chrono::milliseconds(SOUND_DECODE_INTERVAL_MS));
+    }
+  }
+}
+
+// Expects decoderMutex to be held. Returns false if there was nothing to decode.
+bool SoundHandler::decodeChunk() {
+  if(!current) return false;
+
+  // The current sound is fully decoded, continue as soon as the next one is preloaded
+  if(streamEnded) return continueWithPreloaded();
+
+  // A full ring buffer is the normal state while the decoder is ahead of the device
+  if(ring.availableWrite() < SOUND_DECODE_CHUNK_FRAMES) return false;
+
+  ma_uint64 framesDecoded = 0;
+  ma_decoder_read_pcm_frames(&current->decoder, decodeBuffer.data(), SOUND_DECODE_CHUNK_FRAMES, &framesDecoded);
+  ring.write(decodeBuffer.data(), framesDecoded);
+
+  if(framesDecoded < SOUND_DECODE_CHUNK_FRAMES) {
+    streamEnded = true;
+    continueWithPreloaded();
+  }
+  return true;
+}
+
+// Expects decoderMutex to be held
+bool SoundHandler::continueWithPreloaded() {
+  if(boundaries.full()) return false;
+  SoundStream* upcoming = next.exchange(nullptr);
+  if(!upcoming) return false;
+
+  retiredStreams.push_back(current);
+  current = upcoming;
+  boundaries.push((SoundBoundary){.position = ring.getWritePos(), .stream = upcoming});
+  streamEnded = false;
+  return true;
+}
+
+// Expects decoderMutex to be held and the device to be stopped
+void SoundHandler::resetPlayback(SoundStream* stream, uint64_t positionInFrames) {
+  current = stream;
+  playing.store(stream);
+  ring.reset();
+  boundaries.clear();
+  playedFrames.store(positionInFrames);
+  trackSwitched = false;
+  streamEnded = false;
+  endOfStream = false;
+  endOfStreamPosted = false;
+
+  // Decode the first chunk right away so the device does not start on an empty ring
+  decodeChunk();
+}
+
+SoundStream* SoundHandler::openStream(const std::string& filepath) {
+  SoundStream* stream = new SoundStream();
+  ma_decoder_config decoderConfig = ma_decoder_config_init(SOUND_OUTPUT_FORMAT, SOUND_OUTPUT_CHANNELS, SOUND_OUTPUT_SAMPLE_RATE);
+  if (ma_decoder_init_file(filepath.c_str(), &decoderConfig, &stream->decoder) != MA_SUCCESS) {
+    delete stream;
+    return nullptr;
+  }
+  stream->path = filepath;
+
+  stream->lengthInSeconds = SoundDuration::get(filepath);
+  return stream;
+}
+
+void SoundHandler::closeStream(SoundStream* stream) {
+  if(!stream) return;
+  ma_decoder_uninit(&stream->decoder);
+  delete stream;
 }
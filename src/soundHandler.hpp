@@ -1,13 +1,32 @@
 #pragma once
 #include "config.hpp"
 #include "log.hpp"
+#include "ringBuffer.hpp"
 
 #include <string>
+#include <vector>
 #include <stdint.h>
 
 #include <miniaudio.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <future>
 #include <mutex>
+#include <thread>
+
+// A decoder that is opened at the fixed output format of the device.
+struct SoundStream {
+  ma_decoder decoder;
+  std::string path;
+  double lengthInSeconds = 0;
+};
+
+// Position in the ring buffer at which the decoder thread continued with the next sound.
+struct SoundBoundary {
+  uint64_t position;
+  SoundStream* stream;
+};
 
 class SoundHandler {
   public:
@@ -18,79 +37,82 @@ class SoundHandler {
 
     uint32_t volume = VOLUME_INIT;
 
-    void init(const std::string& filepath, ma_device_data_proc dataCallback) {
-      std::lock_guard<std::mutex> lock(audioMutex);
-      this->path = filepath;
-      if (ma_decoder_init_file(filepath.c_str(), NULL, &this->decoder) != MA_SUCCESS) {
-        LOG_ERROR("Failed to load Sound '%s'.\n", filepath.c_str());
-        return;
-      }
-
-      ma_device_config deviceConfig = ma_device_config_init(ma_device_type_playback);
-      deviceConfig.playback.format = this->decoder.outputFormat;
-      deviceConfig.playback.channels = this->decoder.outputChannels;
-      deviceConfig.sampleRate = this->decoder.outputSampleRate;
-      deviceConfig.dataCallback = dataCallback;
-      deviceConfig.pUserData         = &this->decoder;
-
-      if (ma_device_init(NULL, &deviceConfig, &this->device) != MA_SUCCESS) {
-        return;
-      }
-      ma_uint64 lengthInFrames;
-      ma_decoder_get_length_in_pcm_frames(&this->decoder, &lengthInFrames);
-      lengthInSeconds = (double)lengthInFrames / decoder.outputSampleRate;
-
-      isInit = true;
-    }
-    void uninit() {
-      std::lock_guard<std::mutex> lock(audioMutex);
-      if(!this->isInit) return;
-      ma_device_stop(&this->device);
-      ma_device_uninit(&this->device);
-      ma_decoder_uninit(&this->decoder);
-      isInit = false;
-    }
-
-    void play() {
-      std::lock_guard<std::mutex> lock(audioMutex);
-      if(this->isPlaying) return;
-      ma_device_start(&this->device);
-      isPlaying = true;
-    }
-    void stop() {
-      std::lock_guard<std::mutex> lock(audioMutex);
-      if(!this->isPlaying) return;
-      ma_device_stop(&this->device);
-      isPlaying = false;
-    }
-
-    double getPositionInSeconds() {
-      std::lock_guard<std::mutex> lock(audioMutex);
-      if(!isInit) return 0.0;
-
-      ma_uint64 cursorInFrames;
-      ma_decoder_get_cursor_in_pcm_frames(&this->decoder, &cursorInFrames);
-      return (double)cursorInFrames / this->decoder.outputSampleRate;
-    }
-    void setPositionInSeconds(double position) {
-      std::lock_guard<std::mutex> lock(audioMutex);
-      ma_uint64 targetFrame = (ma_uint64)(position * this->decoder.outputSampleRate);
-
-      // Stop the device before seeking
-      if(isPlaying)
-        ma_device_stop(&this->device);
-
-      if(ma_decoder_seek_to_pcm_frame(&this->decoder, targetFrame) != MA_SUCCESS) {
-        LOG_ERROR("Sound position in seconds invalid.\n");
-      }
-
-      if(isPlaying)
-        ma_device_start(&this->device);
-    }
+    ~SoundHandler();
+
+    // Opens the playback device and starts the decoder thread (only on the first call)
+    // and makes 'filepath' the current sound. If 'filepath' was preloaded with
+    // preloadNext(), the preloaded decoder is taken over.
+    void init(const std::string& filepath, ma_device_data_proc dataCallback);
+    // Closes all decoders. The playback device stays open.
+    void uninit();
+    // Closes all decoders, stops the decoder thread and closes the playback device.
+    void shutdown();
+
+    void play();
+    void stop();
+
+    // Sample-accurate position of the audible sound, advanced by the data callback. Lock-free.
+    double getPositionInSeconds();
+    uint64_t getPositionInFrames() const { return playedFrames.load(); }
+    void setPositionInSeconds(double position);
+
+    // Opens the decoder of the sound that follows the current one on a worker thread.
+    // The decoder thread continues with it sample-accurately once the current sound ends.
+    void preloadNext(const std::string& filepath);
+    void cancelPreload();
+    // True if the next sound is preloaded or the decoder thread already continued with it
+    bool hasPreloaded();
+
+    // Returns true once after the sound that is audible switched to the preloaded one.
+    bool pollTrackSwitch();
+    // Returns true once after the data callback played the last frame of the current
+    // sound and there was nothing preloaded to continue with.
+    bool pollEndOfStream();
+
+    // Called from the data callback. Only copies frames out of the ring buffer, never blocks.
+    void readFrames(float* output, ma_uint32 frameCount);
+
+    // Times the data callback found less frames in the ring buffer than the device asked for
+    uint64_t getUnderrunCount() const { return underruns.load(); }
 
     ma_device device;
-    ma_decoder decoder;
-    static double getSoundDuration(const std::string& soundPath); 
   private:
+    static SoundStream* openStream(const std::string& filepath);
+    static void closeStream(SoundStream* stream);
+
+    void decodeLoop();
+    bool decodeChunk();
+    bool continueWithPreloaded();
+    void resetPlayback(SoundStream* stream, uint64_t positionInFrames);
+
+    bool deviceInit = false;
+
+    PcmRingBuffer ring;
+    SpscQueue<SoundBoundary, 8> boundaries;
+    std::vector<float> decodeBuffer;
+
+    // Stream the decoder thread reads from. Guarded by decoderMutex.
+    SoundStream* current = nullptr;
+    // Streams that were fully decoded but may still be audible. Guarded by decoderMutex.
+    std::vector<SoundStream*> retiredStreams;
+    // Stream whose frames the data callback is playing right now
+    std::atomic<SoundStream*> playing{nullptr};
+    std::atomic<SoundStream*> next{nullptr};
+
+    std::atomic<uint64_t> playedFrames{0};
+    std::atomic<uint64_t> underruns{0};
+    std::atomic<bool> trackSwitched{false}, streamEnded{false};
+    std::atomic<bool> endOfStream{false};
+    // Only touched by the data callback (or while the device is stopped)
+    bool endOfStreamPosted = false;
+
+    std::thread decoderThread;
+    std::atomic<bool> decoderRunning{false};
+    std::condition_variable decoderWake;
+    std::mutex decoderMutex;
+
+    std::future<void> preloadFuture;
+    std::string preloadPath;
+
     std::mutex audioMutex;
 };
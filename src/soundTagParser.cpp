@@ -1,6 +1,6 @@
 #include "soundTagParser.hpp"
 #include "log.hpp"
-#include "soundHandler.hpp"
+#include "soundDuration.hpp"
 #include "utils.hpp"
 
 #include <taglib/tag.h>
@@ -10,186 +10,158 @@
 #include <taglib/id3v2frame.h>
 #include <taglib/mpegheader.h>
 #include <taglib/attachedpictureframe.h>
+#include <taglib/textidentificationframe.h>
 #include <taglib/tfile.h>
+#include <taglib/audioproperties.h>
 
 #include <iostream>
 
 using namespace TagLib;
 
-namespace SoundTagParser {
-  LfTexture getSoundThubmnail(const std::string& soundPath, vec2s size_factor) {
-    MPEG::File file(soundPath.c_str());
+// Copies the first attached picture of the tag into 'picture'
+static bool getAttachedPicture(ID3v2::Tag* tag, const std::string& soundPath, std::vector<uint8_t>& picture) {
+  if (!tag) {
+    LOG_ERROR("No ID3v2 tag found for file '%s'.\n", soundPath.c_str());
+    return false;
+  }
 
-    LfTexture tex = {0};
-    // Get the ID3v2 tag
-    ID3v2::Tag *tag = file.ID3v2Tag();
-    if (!tag) {
-      LOG_ERROR("No ID3v2 tag found for file '%s'.\n", soundPath.c_str());
-      return tex;
+  // Get the first APIC (Attached Picture) frame
+  ID3v2::FrameList apicFrames = tag->frameListMap()["APIC"];
+  if (apicFrames.isEmpty()) {
+    LOG_ERROR("No APIC frame found for file '%s'.\n", soundPath.c_str());
+    return false;
+  }
+
+  // Extract the image data
+  ID3v2::AttachedPictureFrame *apicFrame = dynamic_cast<ID3v2::AttachedPictureFrame *>(apicFrames.front());
+  if (!apicFrame) {
+    LOG_ERROR("Failed to cast APIC frame for file '%s'.\n", soundPath.c_str());
+    return false;
+  }
+
+  ByteVector imageData = apicFrame->picture();
+  picture.assign((const uint8_t*)imageData.data(), (const uint8_t*)imageData.data() + imageData.size());
+  return true;
+}
+
+// The URL that yt-dlp embeds as user defined text ("purl"), otherwise the first user defined text
+static std::string getUserTextURL(ID3v2::Tag* tag) {
+  if(!tag) return "";
+  ID3v2::FrameList txxxFrames = tag->frameListMap()["TXXX"];
+  std::string url = "";
+  for(ID3v2::Frame* frame : txxxFrames) {
+    ID3v2::UserTextIdentificationFrame* txxx = dynamic_cast<ID3v2::UserTextIdentificationFrame*>(frame);
+    // The first field is the description
+    if(!txxx || txxx->fieldList().size() < 2) continue;
+    if(txxx->description() == "purl")
+      return txxx->fieldList()[1].to8Bit(true);
+    if(url.empty())
+      url = txxx->fieldList()[1].to8Bit(true);
+  }
+  return url;
+}
+
+namespace SoundTagParser {
+  SoundTags parse(const std::string& soundPath, bool readPicture) {
+    SoundTags tags{};
+    // The audio properties come from the same headers SoundDuration reads, only without
+    // the LAME delay and padding, so the list may differ from the slider by a few milliseconds
+    FileRef fileRef(soundPath.c_str(), true, AudioProperties::Average);
+    if(fileRef.isNull()) {
+      LOG_ERROR("Failed to read tags of file '%s'.\n", soundPath.c_str());
+      return tags;
     }
 
-    // Get the first APIC (Attached Picture) frame
-    ID3v2::FrameList apicFrames = tag->frameListMap()["APIC"];
-    if (apicFrames.isEmpty()) {
-      LOG_ERROR("No APIC frame found for file '%s'.\n", soundPath.c_str());
-      return tex;
+    if(fileRef.tag()) {
+      Tag* tag = fileRef.tag();
+      tags.artist = tag->artist().to8Bit(true);
+      tags.title = tag->title().to8Bit(true);
+      tags.album = tag->album().to8Bit(true);
+      tags.releaseYear = tag->year();
     }
 
-    // Extract the image data
-    ID3v2::AttachedPictureFrame *apicFrame = dynamic_cast<ID3v2::AttachedPictureFrame *>(apicFrames.front());
-    if (!apicFrame) {
-      LOG_ERROR("Failed to cast APIC frame for file '%s'.\n", soundPath.c_str());
-      return tex;
+    // Formats TagLib has no properties for are measured separately
+    if(fileRef.audioProperties() && fileRef.audioProperties()->lengthInMilliseconds() > 0)
+      tags.duration = fileRef.audioProperties()->lengthInMilliseconds() / 1000.0;
+    else
+      tags.duration = SoundDuration::get(soundPath);
+
+    // URL and artwork only live in the ID3v2 tag
+    MPEG::File* mpegFile = dynamic_cast<MPEG::File*>(fileRef.file());
+    if(mpegFile) {
+      ID3v2::Tag* id3v2Tag = mpegFile->ID3v2Tag();
+      tags.url = getUserTextURL(id3v2Tag);
+      if(readPicture && getAttachedPicture(id3v2Tag, soundPath, tags.picture))
+        tags.artworkHash = LyssaUtils::hashBytes(tags.picture.data(), tags.picture.size());
     }
 
-    ByteVector imageData = apicFrame->picture();
+    return tags;
+  }
+
+  LfTexture loadThumbnail(const std::vector<uint8_t>& picture, vec2s size_factor) {
+    LfTexture tex = {0};
+    if(picture.empty()) return tex;
 
     if(size_factor.x == -1 || size_factor.y == -1)
-      tex = lf_load_texture_from_memory(imageData.data(), (int)imageData.size(), true, LF_TEX_FILTER_LINEAR);
+      tex = lf_load_texture_from_memory(picture.data(), (int)picture.size(), true, LF_TEX_FILTER_LINEAR);
     else 
-      tex = lf_load_texture_from_memory_resized_to_fit(imageData.data(), (int)imageData.size(), true, LF_TEX_FILTER_LINEAR, (int32_t)size_factor.x, (int32_t)size_factor.y);
+      tex = lf_load_texture_from_memory_resized_to_fit(picture.data(), (int)picture.size(), true, LF_TEX_FILTER_LINEAR, (int32_t)size_factor.x, (int32_t)size_factor.y);
 
     return tex;
   }
 
-  TextureData getSoundThubmnailData(const std::string& soundPath, vec2s size_factor) {
-    MPEG::File file(soundPath.c_str());
+  TextureData loadThumbnailData(const std::vector<uint8_t>& picture, const std::string& soundPath, vec2s size_factor) {
     TextureData retData{};
-
-    // Get the ID3v2 tag
-    ID3v2::Tag *tag = file.ID3v2Tag();
-    if (!tag) {
-      LOG_ERROR("No ID3v2 tag found for file '%s'.\n", soundPath.c_str());
-      return retData;
-    }
-
-    // Get the first APIC (Attached Picture) frame
-    ID3v2::FrameList apicFrames = tag->frameListMap()["APIC"];
-    if (apicFrames.isEmpty()) {
-      LOG_ERROR("No APIC frame found for file '%s'.\n", soundPath.c_str());
-      return retData;
-    }
-
-    // Extract the image data
-    ID3v2::AttachedPictureFrame *apicFrame = dynamic_cast<ID3v2::AttachedPictureFrame *>(apicFrames.front());
-    if (!apicFrame) {
-      LOG_ERROR("Failed to cast APIC frame for file '%s'.\n", soundPath.c_str());
-      return retData;
-    }
-
-    ByteVector imageData = apicFrame->picture();
+    if(picture.empty()) return retData;
 
     if(size_factor.x == -1 || size_factor.y == -1) {
-      retData.data = lf_load_texture_data_from_memory(imageData.data(), (size_t)imageData.size(), (int32_t*)&retData.width, (int32_t*)&retData.height, &retData.channels, true); 
+      retData.data = lf_load_texture_data_from_memory(picture.data(), picture.size(), (int32_t*)&retData.width, (int32_t*)&retData.height, &retData.channels, true); 
     } else  {
-      retData.data = lf_load_texture_data_from_memory_resized(imageData.data(), (size_t)imageData.size(), 
-          (int32_t*)&retData.channels, (int32_t*)&retData.width, (int32_t*)&retData.height,  true, 48, 27); 
+      retData.data = lf_load_texture_data_from_memory_resized(picture.data(), picture.size(), 
+          (int32_t*)&retData.channels, (int32_t*)&retData.width, (int32_t*)&retData.height, true, (uint32_t)size_factor.x, (uint32_t)size_factor.y); 
     }
     retData.path = soundPath;
 
     return retData;
   }
 
-  std::string getSoundArtist(const std::string& soundPath) {
-    TagLib::FileRef file(soundPath.c_str());
-    if (!file.isNull() && file.tag()) {
-      TagLib::Tag *tag = file.tag();
-
-      return tag->artist().to8Bit(true);
-    } else {
-      return "None"; 
-    }
-  }
-  std::string getSoundAlbum(const std::string& soundPath) {
-    TagLib::FileRef file(soundPath.c_str());
-    if (!file.isNull() && file.tag()) {
-      TagLib::Tag *tag = file.tag();
-
-      return tag->album().to8Bit(true);
-    } else {
-      return "None";
-    } 
-  }
-  std::string getSoundTitle(const std::string& soundPath) {
-    TagLib::FileRef file(soundPath.c_str());
-    if (!file.isNull() && file.tag()) {
-      TagLib::Tag *tag = file.tag();
-
-      return tag->title().to8Bit(true);
-    } else {
-      return "No Title";
-    }
-  }
-  int32_t getSoundDuration(const std::string& soundPath) {
-    FileRef fileRef(soundPath.c_str());
-
-    if (!fileRef.isNull() && fileRef.audioProperties()) {
-      AudioProperties *properties = fileRef.audioProperties();
-      int durationInSeconds = properties->length();
-      return durationInSeconds;
-    } else {
-      return 0;
-    }
+  std::vector<uint8_t> getSoundPicture(const std::string& soundPath) {
+    MPEG::File file(soundPath.c_str(), false);
+    std::vector<uint8_t> picture;
+    getAttachedPicture(file.ID3v2Tag(), soundPath, picture);
+    return picture;
   }
-  uint32_t getSoundReleaseYear(const std::string& soundPath) {
-    FileRef file(soundPath.c_str());
 
-    if (!file.isNull() && file.tag()) {
-      Tag *tag = file.tag();
-
-      return tag->year();
-    } 
-    return 0;
+  LfTexture getSoundThubmnail(const std::string& soundPath, vec2s size_factor) {
+    return loadThumbnail(getSoundPicture(soundPath), size_factor);
   }
 
-  std::string getSoundComment(const std::string& soundPath) {
-    std::string cmd = "exiftool -s -s -s -UserDefinedText \"" + soundPath + "\" | awk '{print $2}'";
-    return LyssaUtils::getCommandOutput(cmd);
+  TextureData getSoundThubmnailData(const std::string& soundPath, vec2s size_factor) {
+    return loadThumbnailData(getSoundPicture(soundPath), soundPath, size_factor);
   }
+
   bool isValidSoundFile(const std::string &path) {
     TagLib::FileRef file(path.c_str());
     return !file.isNull() && file.audioProperties();
   }
   SoundMetadata getSoundMetadata(const std::string& soundPath) {
+    SoundTags tags = parse(soundPath);
     SoundMetadata metadata;
-    metadata.thumbnailData = getSoundThubmnailData(soundPath, (vec2s){120, 80});
-    metadata.duration = SoundHandler::getSoundDuration(soundPath);
-
-    FileRef file(soundPath.c_str());
-
-    if (!file.isNull() && file.tag()) {
-      Tag *tag = file.tag();
-
-      metadata.artist = tag->artist().to8Bit(true) == "" ? "-" : tag->artist().to8Bit(true);
-      metadata.releaseYear = tag->year();
-      metadata.title = tag->title().to8Bit(true);
-    } else {
-      metadata.artist = "-";
-      metadata.title = "-";
-      metadata.releaseYear = 0;
-    }
-    metadata.comment = getSoundComment(soundPath);
-
+    metadata.thumbnailData = loadThumbnailData(tags.picture, soundPath, (vec2s){120, 80});
+    metadata.duration = tags.duration;
+    metadata.artist = tags.artist.empty() ? "-" : tags.artist;
+    metadata.title = tags.title.empty() ? "-" : tags.title;
+    metadata.releaseYear = tags.releaseYear;
+    metadata.comment = tags.url;
     return metadata;
   }
   SoundMetadata getSoundMetadataNoThumbnail(const std::string& soundPath) {
+    SoundTags tags = parse(soundPath, false);
     SoundMetadata metadata;
-    metadata.duration = SoundTagParser::getSoundDuration(soundPath);
-
-    FileRef file(soundPath.c_str());
-
-    if (!file.isNull() && file.tag()) {
-      Tag *tag = file.tag();
-
-      metadata.artist = tag->artist().to8Bit(true) == "" ? "-" : tag->artist().to8Bit(true);
-      metadata.releaseYear = tag->year();
-      metadata.title = tag->title().to8Bit(true);
-    } else {
-      metadata.artist = "-";
-      metadata.title = "-";
-      metadata.releaseYear = 0;
-    }
-
+    metadata.duration = tags.duration;
+    metadata.artist = tags.artist.empty() ? "-" : tags.artist;
+    metadata.title = tags.title.empty() ? "-" : tags.title;
+    metadata.releaseYear = tags.releaseYear;
     return metadata;
   }
 }
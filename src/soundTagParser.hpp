@@ -4,6 +4,8 @@ extern "C" {
 #include <leif/leif.h>
 }
 #include <string>
+#include <vector>
+#include <stdint.h>
 
 #include "textureData.hpp"
 
@@ -15,15 +17,31 @@ struct SoundMetadata {
   double duration;
 };
 
+// Everything that is read from a sound file in one go, see SoundTagParser::parse().
+// Fields that are not tagged stay empty/0.
+struct SoundTags {
+  std::string artist, title, album;
+  std::string url;
+  uint32_t releaseYear = 0;
+  double duration = 0;
+  // Encoded image bytes of the first attached picture (APIC)
+  std::vector<uint8_t> picture;
+  // Hash of 'picture', 0 if the sound has no artwork
+  uint64_t artworkHash = 0;
+};
+
 namespace SoundTagParser {
+  // Opens the file once and reads all tag fields, the duration and the attached picture.
+  // Only files without TagLib audio properties are opened again by SoundDuration.
+  SoundTags parse(const std::string& soundPath, bool readPicture = true);
+
+  LfTexture loadThumbnail(const std::vector<uint8_t>& picture, vec2s size_factor = (vec2s){-1, -1});
+  TextureData loadThumbnailData(const std::vector<uint8_t>& picture, const std::string& soundPath, vec2s size_factor = (vec2s){-1, -1});
+
+  // Encoded bytes of the first attached picture, empty if there is none
+  std::vector<uint8_t> getSoundPicture(const std::string& soundPath);
   LfTexture getSoundThubmnail(const std::string& soundPath, vec2s size_factor = (vec2s){-1, -1});
   TextureData getSoundThubmnailData(const std::string& soundPath, vec2s size_factor = (vec2s){-1, -1});
-  std::string getSoundArtist(const std::string& soundPath);
-  std::string getSoundAlbum(const std::string& soundPath);
-  std::string getSoundTitle(const std::string& soundPath);
-  int32_t getSoundDuration(const std::string& soundPath);
-  uint32_t getSoundReleaseYear(const std::string& soundPath);
-  std::string getSoundComment(const std::string& soundPath);
   SoundMetadata getSoundMetadata(const std::string& soundPath);
   SoundMetadata getSoundMetadataNoThumbnail(const std::string& soundPath);
   bool isValidSoundFile(const std::string& path);
@@ -0,0 +1,126 @@
+#include "textureUploader.hpp"
+#include "config.hpp"
+#include "log.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+
+struct PendingUpload {
+  uint64_t key;
+  TextureData pixels;
+};
+
+static std::deque<PendingUpload> queue;
+static GLuint pbos[TEXTURE_UPLOAD_PBO_COUNT];
+static uint32_t nextPbo = 0;
+static bool initialized = false;
+
+static uint64_t getPixelSize(const TextureData& pixels) {
+  return (uint64_t)pixels.width * pixels.height * pixels.channels;
+}
+
+static GLenum getFormat(int32_t channels) {
+  switch(channels) {
+    case 1: return GL_RED;
+    case 2: return GL_RG;
+    case 3: return GL_RGB;
+    default: return GL_RGBA;
+  }
+}
+
+// Creates the texture from the bound pixel buffer at 'offset'
+static LfTexture createTexture(const TextureData& pixels, uint64_t offset) {
+  LfTexture tex = {0};
+  GLenum format = getFormat(pixels.channels);
+  glGenTextures(1, &tex.id);
+  glBindTexture(GL_TEXTURE_2D, tex.id);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexImage2D(GL_TEXTURE_2D, 0, format, pixels.width, pixels.height, 0, format, GL_UNSIGNED_BYTE, (const void*)offset);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  tex.width = pixels.width;
+  tex.height = pixels.height;
+  return tex;
+}
+
+namespace TextureUploader {
+  void init() {
+    if(initialized) return;
+    glGenBuffers(TEXTURE_UPLOAD_PBO_COUNT, pbos);
+    initialized = true;
+  }
+
+  void shutdown() {
+    if(!initialized) return;
+    for(auto& upload : queue) {
+      free(upload.pixels.data);
+    }
+    queue.clear();
+    glDeleteBuffers(TEXTURE_UPLOAD_PBO_COUNT, pbos);
+    initialized = false;
+  }
+
+  void enqueue(uint64_t key, const TextureData& pixels) {
+    if(!pixels.data) return;
+    queue.emplace_back((PendingUpload){.key = key, .pixels = pixels});
+  }
+
+  void process(const std::function<void(uint64_t key, LfTexture texture)>& uploaded) {
+    if(!initialized || queue.empty()) return;
+
+    // Pick the uploads of this frame, rows start at 4 byte aligned offsets
+    uint32_t count = 0;
+    uint64_t bufferSize = 0;
+    while(count < queue.size() && count < TEXTURE_UPLOADS_PER_FRAME) {
+      uint64_t size = (getPixelSize(queue[count].pixels) + 3) & ~3ull;
+      if(count != 0 && bufferSize + size > TEXTURE_UPLOAD_BYTES_PER_FRAME) break;
+      bufferSize += size;
+      count++;
+    }
+
+    // Cycling through the buffers and orphaning them keeps the driver from
+    // waiting for the transfers of the previous frames.
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[nextPbo]);
+    nextPbo = (nextPbo + 1) % TEXTURE_UPLOAD_PBO_COUNT;
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, std::max<uint64_t>(bufferSize, TEXTURE_UPLOAD_BYTES_PER_FRAME), nullptr, GL_STREAM_DRAW);
+    uint8_t* mapped = (uint8_t*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bufferSize,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if(!mapped) {
+      LOG_ERROR("Failed to map texture upload buffer.\n");
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      return;
+    }
+
+    std::vector<uint64_t> offsets(count);
+    uint64_t offset = 0;
+    for(uint32_t i = 0; i < count; i++) {
+      TextureData& pixels = queue[i].pixels;
+      offsets[i] = offset;
+      memcpy(mapped + offset, pixels.data, getPixelSize(pixels));
+      offset += (getPixelSize(pixels) + 3) & ~3ull;
+      // The pixels live in the buffer now
+      free(pixels.data);
+      pixels.data = nullptr;
+    }
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    GLint alignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for(uint32_t i = 0; i < count; i++) {
+      PendingUpload upload = queue.front();
+      queue.pop_front();
+      uploaded(upload.key, createTexture(upload.pixels, offsets[i]));
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+}
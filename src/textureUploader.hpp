@@ -0,0 +1,27 @@
+#pragma once
+
+#include "textureData.hpp"
+
+extern "C" {
+#include <leif/leif.h>
+}
+
+#include <functional>
+
+#include <stdint.h>
+
+// Queue of pending texture uploads that is worked off a bit every frame.
+// The pixels of one frame are copied into a pixel buffer object in one go, the
+// driver then transfers them to the textures without blocking the render thread.
+// Everything in here must be called from the thread that owns the GL context.
+namespace TextureUploader {
+  void init();
+  void shutdown();
+
+  // Takes ownership of pixels.data, it is freed once the upload completed. 'key' identifies the upload.
+  void enqueue(uint64_t key, const TextureData& pixels);
+
+  // Uploads queued textures until TEXTURE_UPLOAD_BYTES_PER_FRAME or TEXTURE_UPLOADS_PER_FRAME
+  // is reached. At least one texture gets uploaded per call if any is queued.
+  void process(const std::function<void(uint64_t key, LfTexture texture)>& uploaded);
+}
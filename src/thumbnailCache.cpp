@@ -0,0 +1,127 @@
+#include "thumbnailCache.hpp"
+#include "config.hpp"
+#include "log.hpp"
+#include "utils.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define THUMBNAIL_CACHE_MAGIC "LYTH"
+
+struct ThumbnailHeader {
+  char magic[4];
+  uint32_t width, height;
+  int32_t channels;
+};
+
+static std::string getBlobPath(uint64_t hash, uint32_t width, uint32_t height) {
+  char name[64];
+  snprintf(name, sizeof(name), "/%016llx_%ux%u.rgba", (unsigned long long)hash, width, height);
+  return THUMBNAIL_CACHE_DIR + std::string(name);
+}
+
+namespace ThumbnailCache {
+  bool load(uint64_t hash, uint32_t width, uint32_t height, TextureData& data) {
+    int fd = open(getBlobPath(hash, width, height).c_str(), O_RDONLY);
+    if(fd == -1) return false;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ThumbnailHeader)) {
+      close(fd);
+      return false;
+    }
+    void* blob = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(blob == MAP_FAILED) return false;
+
+    const ThumbnailHeader* header = (const ThumbnailHeader*)blob;
+    uint64_t pixelSize = (uint64_t)header->width * header->height * header->channels;
+    if(memcmp(header->magic, THUMBNAIL_CACHE_MAGIC, 4) != 0 || header->channels <= 0 || header->channels > 4 ||
+        sizeof(ThumbnailHeader) + pixelSize != (uint64_t)st.st_size) {
+      munmap(blob, st.st_size);
+      return false;
+    }
+
+    data.width = header->width;
+    data.height = header->height;
+    data.channels = header->channels;
+    data.data = (unsigned char*)malloc(pixelSize);
+    memcpy(data.data, (const uint8_t*)blob + sizeof(ThumbnailHeader), pixelSize);
+    munmap(blob, st.st_size);
+    return true;
+  }
+
+  void store(uint64_t hash, uint32_t width, uint32_t height, const TextureData& data) {
+    if(!data.data || data.channels <= 0) return;
+    if(!std::filesystem::exists(THUMBNAIL_CACHE_DIR)) {
+      std::filesystem::create_directories(THUMBNAIL_CACHE_DIR);
+    }
+
+    ThumbnailHeader header = {
+      .magic = {'L', 'Y', 'T', 'H'},
+      .width = data.width,
+      .height = data.height,
+      .channels = data.channels,
+    };
+
+    // Other loaders may store the same artwork at the same time, each writes its own file
+    std::string blobPath = getBlobPath(hash, width, height);
+    static std::atomic<uint32_t> tmpCounter{0};
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%d.%u.tmp", (int)getpid(), tmpCounter.fetch_add(1));
+    std::string tmpPath = blobPath + suffix;
+    {
+      std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+      if(!file.is_open()) {
+        LOG_ERROR("Failed to write thumbnail cache file '%s'.\n", tmpPath.c_str());
+        return;
+      }
+      file.write((const char*)&header, sizeof(header));
+      file.write((const char*)data.data, (uint64_t)data.width * data.height * data.channels);
+    }
+    if(std::rename(tmpPath.c_str(), blobPath.c_str()) != 0) {
+      std::remove(tmpPath.c_str());
+    }
+  }
+
+  TextureData getTrackThumbnailData(const std::string& soundPath, const SoundTags& tags, vec2s size) {
+    TextureData data{};
+    if(tags.artworkHash == 0) return data;
+
+    if(load(tags.artworkHash, (uint32_t)size.x, (uint32_t)size.y, data)) {
+      data.path = soundPath;
+      return data;
+    }
+
+    data = SoundTagParser::loadThumbnailData(tags.picture.empty() ? SoundTagParser::getSoundPicture(soundPath) : tags.picture,
+        soundPath, size);
+    store(tags.artworkHash, (uint32_t)size.x, (uint32_t)size.y, data);
+    return data;
+  }
+
+  TextureData getCoverData(const std::filesystem::path& imagePath) {
+    std::ifstream file(imagePath, std::ios::binary);
+    if(!file.is_open()) {
+      LOG_ERROR("Failed to open playlist cover '%s'.\n", imagePath.string().c_str());
+      return TextureData{};
+    }
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    uint64_t hash = LyssaUtils::hashBytes(bytes.data(), bytes.size());
+
+    TextureData data{};
+    if(!load(hash, PLAYLIST_COVER_SIZE, PLAYLIST_COVER_SIZE, data)) {
+      data.data = lf_load_texture_data_from_memory_resized(bytes.data(), bytes.size(), &data.channels,
+          (int32_t*)&data.width, (int32_t*)&data.height, false, PLAYLIST_COVER_SIZE, PLAYLIST_COVER_SIZE);
+      store(hash, PLAYLIST_COVER_SIZE, PLAYLIST_COVER_SIZE, data);
+    }
+    return data;
+  }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "soundTagParser.hpp"
+#include "textureData.hpp"
+
+extern "C" {
+#include <leif/leif.h>
+}
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+// Content-addressed store of pre-scaled, already decoded thumbnails in THUMBNAIL_CACHE_DIR.
+// Every blob holds the raw pixels of one image at one size and is keyed by the hash
+// of the encoded image, so a hit is a memory-mapped read without any image decoding.
+namespace ThumbnailCache {
+  bool load(uint64_t hash, uint32_t width, uint32_t height, TextureData& data);
+  void store(uint64_t hash, uint32_t width, uint32_t height, const TextureData& data);
+
+  // Row thumbnail of a track at 'size'. Uses tags.picture if it was read,
+  // otherwise the picture is only read from the file on a cache miss.
+  TextureData getTrackThumbnailData(const std::string& soundPath, const SoundTags& tags, vec2s size);
+
+  // Pixels of a playlist cover scaled to PLAYLIST_COVER_SIZE, decoded on the job system
+  TextureData getCoverData(const std::filesystem::path& imagePath);
+}
@@ -0,0 +1,148 @@
+#include "trackLibrary.hpp"
+
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <string.h>
+#include <sys/stat.h>
+
+#define STRING_BLOCK_SIZE (64 * 1024)
+
+// Index of an interned string, 0 is the empty string
+typedef uint32_t StringId;
+#define INVALID_STRING_ID UINT32_MAX
+
+// Interned strings are appended to blocks that never move, so the views into them stay valid.
+// Every string is followed by a NUL, its data can be handed to the renderer as it is.
+static std::vector<std::unique_ptr<char[]>> stringBlocks;
+static uint32_t stringBlockUsed = STRING_BLOCK_SIZE;
+static std::vector<std::string_view> strings = {""};
+static std::unordered_map<std::string_view, StringId> stringIds;
+
+// The columns of the tracks, indexed by the TrackId
+static std::vector<StringId> directories, filenames, titles, artists;
+static std::vector<uint32_t> releaseYears;
+static std::vector<int32_t> durations;
+static std::vector<uint64_t> artworkHashes;
+static std::vector<bool> loaded;
+static std::vector<FileStamp> stamps;
+// Directory and filename of a track, see getPathKey()
+static std::unordered_map<uint64_t, TrackId> ids;
+
+static StringId findString(std::string_view str) {
+  if(str.empty()) return 0;
+  auto it = stringIds.find(str);
+  return it != stringIds.end() ? it->second : INVALID_STRING_ID;
+}
+
+static StringId internString(std::string_view str) {
+  StringId id = findString(str);
+  if(id != INVALID_STRING_ID) return id;
+
+  size_t size = str.size() + 1;
+  char* data;
+  if(size > STRING_BLOCK_SIZE) {
+    // Gets a block of its own, the next string starts a new one
+    stringBlocks.emplace_back(new char[size]);
+    data = stringBlocks.back().get();
+    stringBlockUsed = STRING_BLOCK_SIZE;
+  } else {
+    if(stringBlockUsed + size > STRING_BLOCK_SIZE) {
+      stringBlocks.emplace_back(new char[STRING_BLOCK_SIZE]);
+      stringBlockUsed = 0;
+    }
+    data = stringBlocks.back().get() + stringBlockUsed;
+    stringBlockUsed += size;
+  }
+  memcpy(data, str.data(), str.size());
+  data[str.size()] = '\0';
+
+  id = strings.size();
+  strings.emplace_back(data, str.size());
+  stringIds.emplace(strings.back(), id);
+  return id;
+}
+
+static uint64_t getPathKey(StringId directory, StringId filename) {
+  return ((uint64_t)directory << 32) | filename;
+}
+
+namespace TrackLibrary {
+  TrackId intern(const std::filesystem::path& path) {
+    std::filesystem::path normal = path.lexically_normal();
+    StringId directory = internString(normal.parent_path().string());
+    StringId filename = internString(normal.filename().string());
+    auto [it, inserted] = ids.try_emplace(getPathKey(directory, filename), (TrackId)directories.size());
+    if(!inserted) return it->second;
+
+    directories.emplace_back(directory);
+    filenames.emplace_back(filename);
+    titles.emplace_back(0);
+    artists.emplace_back(0);
+    releaseYears.emplace_back(0);
+    durations.emplace_back(0);
+    artworkHashes.emplace_back(0);
+    loaded.emplace_back(false);
+    stamps.emplace_back();
+    return it->second;
+  }
+
+  TrackId find(const std::filesystem::path& path) {
+    std::filesystem::path normal = path.lexically_normal();
+    StringId directory = findString(normal.parent_path().string());
+    StringId filename = findString(normal.filename().string());
+    if(directory == INVALID_STRING_ID || filename == INVALID_STRING_ID) return INVALID_TRACK_ID;
+    auto it = ids.find(getPathKey(directory, filename));
+    return it != ids.end() ? it->second : INVALID_TRACK_ID;
+  }
+
+  void store(TrackId id, const SoundFile& file) {
+    titles[id] = internString(file.title);
+    artists[id] = internString(file.artist);
+    releaseYears[id] = file.releaseYear;
+    durations[id] = file.duration;
+    artworkHashes[id] = file.artworkHash;
+    loaded[id] = true;
+    stamps[id] = file.stamp;
+  }
+
+  FileStamp readStamp(const std::filesystem::path& path) {
+    struct stat st;
+    if(stat(path.c_str(), &st) != 0) return FileStamp();
+    return (FileStamp){
+      .size = (uint64_t)st.st_size,
+      .mtime = (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec
+    };
+  }
+
+  bool isUpToDate(TrackId id) {
+    return loaded[id] && readStamp(getPath(id)) == stamps[id];
+  }
+
+  std::filesystem::path getPath(TrackId id) {
+    return std::filesystem::path(strings[directories[id]]) / strings[filenames[id]];
+  }
+  const char* getTitle(TrackId id) {
+    return strings[titles[id]].data();
+  }
+  const char* getArtist(TrackId id) {
+    return strings[artists[id]].data();
+  }
+  uint32_t getReleaseYear(TrackId id) {
+    return releaseYears[id];
+  }
+  int32_t getDuration(TrackId id) {
+    return durations[id];
+  }
+  uint64_t getArtworkHash(TrackId id) {
+    return artworkHashes[id];
+  }
+  bool isLoaded(TrackId id) {
+    return loaded[id];
+  }
+  FileStamp getStamp(TrackId id) {
+    return stamps[id];
+  }
+}
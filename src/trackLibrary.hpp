@@ -0,0 +1,63 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+#include <stdint.h>
+
+// Size and modification time of a file, the tags of a track are read again once they change
+struct FileStamp {
+  uint64_t size = 0;
+  int64_t mtime = 0;
+
+  bool operator==(const FileStamp& other) const {
+    return size == other.size && mtime == other.mtime;
+  }
+  bool operator!=(const FileStamp& other) const {
+    return !(*this == other);
+  }
+};
+
+// The tags of a track as a loading job reads them, before they are stored in the TrackLibrary
+struct SoundFile {
+  std::filesystem::path path;
+  std::string artist, title;
+  uint32_t releaseYear;
+  int32_t duration;
+  // Key of the row thumbnail in the ArtworkRegistry
+  uint64_t artworkHash = 0;
+  // Of the file the tags were read from, zero if it did not exist
+  FileStamp stamp;
+};
+
+// Index of a track in the TrackLibrary
+typedef uint32_t TrackId;
+#define INVALID_TRACK_ID UINT32_MAX
+
+// Every track that is in a playlist, once per path. Playlists only hold the ids, so a track
+// that is in several playlists (e.g. also in the favourites) shares one entry and its tags are
+// read once. The tracks are stored as columns indexed by the id. Paths, titles and artists are
+// interned into a string arena, a path is stored as its interned directory and filename.
+// Tracks are never removed. Main thread only.
+namespace TrackLibrary {
+  // The id of the track at 'path', an unloaded entry is added if the path is not known yet
+  TrackId intern(const std::filesystem::path& path);
+  // INVALID_TRACK_ID if the path is not known
+  TrackId find(const std::filesystem::path& path);
+  // Stores the tags of 'file' (its path is ignored) and marks the track as loaded
+  void store(TrackId id, const SoundFile& file);
+  // The stamp of the file at 'path', zero if it does not exist. Safe to call from any thread.
+  FileStamp readStamp(const std::filesystem::path& path);
+  // True if the track is loaded and its file did not change since. Does a stat().
+  bool isUpToDate(TrackId id);
+
+  std::filesystem::path getPath(TrackId id);
+  // Empty until the track is loaded. The strings live as long as the process.
+  const char* getTitle(TrackId id);
+  const char* getArtist(TrackId id);
+  uint32_t getReleaseYear(TrackId id);
+  int32_t getDuration(TrackId id);
+  uint64_t getArtworkHash(TrackId id);
+  bool isLoaded(TrackId id);
+  FileStamp getStamp(TrackId id);
+}